@@ -0,0 +1,64 @@
+#include <string.h>
+#include "BatterySave.h"
+
+#ifndef ARDUINO
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+BatterySave::BatterySave() : console(0), mapped(0) {}
+
+BatterySave::~BatterySave() {
+  close();
+}
+
+bool BatterySave::open(Console* c, const char* path) {
+  close();
+
+  int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) return false;
+
+  // Longer files are left alone, only the first PRG_RAM_SIZE bytes are used
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (info.st_size < PRG_RAM_SIZE && ftruncate(fd, PRG_RAM_SIZE) != 0)) {
+    ::close(fd);
+    return false;
+  }
+
+  void* region = mmap(0, PRG_RAM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (region == MAP_FAILED) return false;
+
+  console = c;
+  mapped = (uint8_t*)region;
+  (*console).cart.prgRam = mapped;
+  (*console).bus.insertCartridge(&(*console).cart);
+  return true;
+}
+
+bool BatterySave::sync() {
+  if (!mapped) return true;
+  return msync(mapped, PRG_RAM_SIZE, MS_ASYNC) == 0;
+}
+
+bool BatterySave::close() {
+  if (!mapped) return true;
+  bool ok = msync(mapped, PRG_RAM_SIZE, MS_SYNC) == 0;
+
+  // Reloading a ROM has already switched the cartridge back
+  Cartridge& cart = (*console).cart;
+  if (cart.prgRam == mapped) {
+    memcpy(cart.prgRamData, mapped, PRG_RAM_SIZE);
+    cart.prgRam = cart.prgRamData;
+    (*console).bus.insertCartridge(&cart);
+  }
+
+  ok = munmap(mapped, PRG_RAM_SIZE) == 0 && ok;
+  mapped = 0;
+  console = 0;
+  return ok;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+#ifndef ARDUINO
+
+// Battery-backed PRG-RAM kept in a .sav file. The file is mapped shared and
+// the cartridge's PRG-RAM points straight at the mapping, so the game's
+// writes go to the page cache through the bus page tables like any other
+// RAM write, with nothing extra on the write path. sync() hands the dirty
+// pages to the kernel for writeback; call it at frame boundaries.
+class BatterySave {
+  public:
+    BatterySave();
+    ~BatterySave();
+
+    // Map the file (created, or extended with zeros, to PRG_RAM_SIZE) as the
+    // console's PRG-RAM, keeping what it already holds. Call after
+    // Console::loadROM, which gives the cartridge fresh RAM. Returns false if
+    // the file can't be opened or mapped.
+    bool open(Console* c, const char* path);
+
+    // Schedule writeback of whatever changed since the last sync
+    bool sync();
+
+    // Write the file back and wait for it, then unmap it. The cartridge gets
+    // its own RAM back, holding the saved contents.
+    bool close();
+
+  private:
+    Console* console;
+    uint8_t* mapped;
+};
+
+#endif
@@ -1,17 +1,106 @@
+#include <string.h>
 #include "Bus.h"
+#include "PPU.h"
+#include "Cartridge.h"
+#include "Footprint.h"
+#ifdef CPU_DEBUG
+#include "Debugger.h"
+#endif
+
+Bus::Bus() : ppu(0), cart(0), syncAccess(0), syncContext(0), pollHook(0), pollContext(0) {
+  reset();
+  mapPages();
+}
 
-Bus::Bus() {}
 Bus::~Bus() {}
 
-void Bus::write(uint16_t address, uint8_t value) {
-  if (address >= 0 && address <= 0xffff) {
-    ram[address] = value;
+void Bus::connectToPPU(PPU* p) {
+  ppu = p;
+}
+
+void Bus::insertCartridge(Cartridge* c) {
+  cart = c;
+  mapPages();
+}
+
+void Bus::reset() {
+  memset(ram, 0, sizeof(ram));
+  controllers[0].reset();
+  controllers[1].reset();
+  stallCycles = 0;
+}
+
+// Point every page that is plain memory straight at its backing storage,
+// everything else (registers, mapper writes) goes through read()/write()
+void Bus::mapPages() {
+  for (int page = 0; page < PAGE_COUNT; page++) {
+    readPages[page] = 0;
+    writePages[page] = 0;
+  }
+
+  for (int page = 0x00; page < 0x20; page++) {
+    readPages[page] = writePages[page] = &ram[(page << 8) & (RAM_SIZE - 1)];
+  }
+
+  if (cart != 0 && (*cart).prgRom != 0) {
+    for (int page = 0x60; page < 0x80; page++) {
+      readPages[page] = writePages[page] = &(*cart).prgRam[(page - 0x60) << 8];
+    }
+
+    for (int page = 0x80; page < 0x100; page++) {
+      readPages[page] = &(*cart).prgRom[((page - 0x80) << 8) & ((*cart).prgRomSize - 1)];
+    }
+  }
+
+#ifdef CPU_DEBUG
+  if (Debugger::active) (*Debugger::active).unmapWatched(this);
+#endif
+}
+
+HOT_CODE void Bus::write(uint16_t address, uint8_t value) {
+  if (syncAccess) syncAccess(syncContext);
+#ifdef CPU_DEBUG
+  if (Debugger::active) (*Debugger::active).access(this, address, WATCH_WRITE, value);
+#endif
+
+  if (address < 0x2000) {
+    ram[address & (RAM_SIZE - 1)] = value;
+  } else if (address < 0x4000) {
+    (*ppu).writeRegister(address, value);
+  } else if (address == 0x4014) {
+    // OAM DMA copies a whole page into sprite memory and stalls the CPU
+    for (int i = 0; i < OAM_SIZE; i++) {
+      (*ppu).writeRegister(0x2004, read((value << 8) | i));
+    }
+    stallCycles += 513;
+  } else if (address == 0x4016) {
+    // One strobe line goes to both ports
+    controllers[0].write(value);
+    controllers[1].write(value);
+  } else if (address >= 0x6000 && cart) {
+    (*cart).writePRG(address, value);
   }
 };
 
-uint8_t Bus::read(uint16_t address) {
-  if (address >= 0 && address <= 0xffff) {
-    return ram[address];
+HOT_CODE uint8_t Bus::read(uint16_t address) {
+  if (syncAccess) syncAccess(syncContext);
+  uint8_t value = readDevice(address);
+#ifdef CPU_DEBUG
+  if (Debugger::active) (*Debugger::active).access(this, address, WATCH_READ, value);
+#endif
+  return value;
+}
+
+HOT_CODE uint8_t Bus::readDevice(uint16_t address) {
+  if (address < 0x2000) return ram[address & (RAM_SIZE - 1)];
+  if (address < 0x4000) return (*ppu).readRegister(address);
+
+  // The upper bits are open bus, which is usually $40 from the address
+  if (address == 0x4016 || address == 0x4017) {
+    if (pollHook) pollHook(pollContext, address & 0x01);
+    return 0x40 | controllers[address & 0x01].read();
   }
+
+  if (address >= 0x6000 && cart && (*cart).prgRom) return (*cart).readPRG(address);
   return 0;
 };
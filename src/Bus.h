@@ -1,21 +1,59 @@
 #pragma once
 
 #include <stdint.h>
-#include "CPU.h"
+#include "Controller.h"
 
-#define RAM_SIZE 1024 * 64
+#define RAM_SIZE 1024 * 2
+#define PAGE_COUNT 256
 
-class CPU6502;
+class PPU;
+class Cartridge;
 
-class Bus {
+// Memory and device state on the CPU bus, kept in one plain block so
+// savestates can copy it
+struct BusState {
+  uint8_t ram[RAM_SIZE];
+
+  // Standard controllers on $4016/$4017
+  Controller controllers[2];
+
+  // CPU cycles stolen by OAM DMA, consumed by the console
+  uint16_t stallCycles;
+};
+
+class Bus : public BusState {
   public:
     Bus();
     ~Bus();
 
+    // Page tables used by the CPU for direct memory access
+    uint8_t* readPages[PAGE_COUNT];
+    uint8_t* writePages[PAGE_COUNT];
+
     // Devices connected to the bus
-    CPU6502 cpu;
-    uint8_t ram[RAM_SIZE];
+    PPU* ppu;
+    Cartridge* cart;
+
+    // Called before every access that goes through read()/write(), so an
+    // engine that steps devices cycle by cycle can bring them up to the
+    // cycle of the access first (see Scheduler.h)
+    void (*syncAccess)(void* context);
+    void* syncContext;
+
+    // Called when a controller port is read (see Latency.h)
+    void (*pollHook)(void* context, uint8_t port);
+    void* pollContext;
+
+    void connectToPPU(PPU* p);
+    void insertCartridge(Cartridge* c);
+    void reset();
 
     void write(uint16_t address, uint8_t value);
     uint8_t read(uint16_t address);
+
+    // Rebuild the page tables, e.g. after the debugger's watchpoints change
+    void mapPages();
+
+  private:
+    uint8_t readDevice(uint16_t address);
 };
@@ -1,10 +1,42 @@
-#include <stdio.h>
 #include "CPU.h"
 #include "Bus.h"
-
-CPU6502::CPU6502() {}
+#include "Profile.h"
+#ifdef CPU_DEBUG
+#include "Debugger.h"
+#endif
+#include "Footprint.h"
+
+CPU6502::CPU6502() {
+  a = x = y = 0;
+  sp = 0xfd;
+  p = 0x24;
+  pc = 0;
+  cycles = 0;
+  totalCycles = 0;
+}
 CPU6502::~CPU6502() {}
 
+// The zero page and stack are always internal RAM, so they skip the bus.
+// Debugger builds send them through the page table instead, so that
+// watchpoints on them are seen.
+inline uint8_t CPU6502::readRAM(uint16_t address) {
+#ifdef CPU_DEBUG
+  return read(address);
+#else
+  CPUProfile::read(address);
+  return ram[address];
+#endif
+}
+
+inline void CPU6502::writeRAM(uint16_t address, uint8_t value) {
+#ifdef CPU_DEBUG
+  write(address, value);
+#else
+  CPUProfile::write(address);
+  ram[address] = value;
+#endif
+}
+
 // Addressing Modes
 void CPU6502::AM_IMP() {
   addressingMode = Implicit;
@@ -21,88 +53,86 @@ void CPU6502::AM_IMM() {
   addressingMode = Immediate;
 };
 
-void CPU6502::AM_ZP() {
+void CPU6502::AM_ZP(bool fetch) {
   currentAddress = read(pc++);
-  currentValue = read(currentAddress);
+  if (fetch) currentValue = readRAM(currentAddress);
   addressingMode = ZeroPage;
 };
 
-void CPU6502::AM_ZPX() {
-  currentAddress = read(pc++) + x;
-  currentValue = read(currentAddress);
+void CPU6502::AM_ZPX(bool fetch) {
+  currentAddress = (uint8_t)(read(pc++) + x);
+  if (fetch) currentValue = readRAM(currentAddress);
   addressingMode = ZeroPageX;
 };
 
-void CPU6502::AM_ZPY() {
-  currentAddress = read(pc++) + y;
-  currentValue = read(currentAddress);
+void CPU6502::AM_ZPY(bool fetch) {
+  currentAddress = (uint8_t)(read(pc++) + y);
+  if (fetch) currentValue = readRAM(currentAddress);
   addressingMode = ZeroPageY;
 };
 
 void CPU6502::AM_REL() {
-  currentAddress = pc;
+  currentAddress = pc++;
   currentValue = read(currentAddress);
   addressingMode = Relative;
 };
 
-void CPU6502::AM_ABS() {
-  if (pc & 0xff == 0xff) pageBoundaryCrossed = 1;
+void CPU6502::AM_ABS(bool fetch) {
   currentAddress = read(pc) | (read(pc + 1) << 8);
-  currentValue = read(currentAddress);
+  if (fetch) currentValue = read(currentAddress);
   pc += 2;
   addressingMode = Absolute;
 };
 
-void CPU6502::AM_ABX() {
-  if (pc & 0xff == 0xff) pageBoundaryCrossed = 1;
-  currentAddress = (read(pc) | (read(pc + 1) << 8)) + x;
-  currentValue = read(currentAddress);
+void CPU6502::AM_ABX(bool fetch) {
+  uint16_t base = read(pc) | (read(pc + 1) << 8);
+  currentAddress = base + x;
+  pageBoundaryCrossed = (base & 0xff00) != (currentAddress & 0xff00);
+  if (fetch) currentValue = read(currentAddress);
   pc += 2;
   addressingMode = AbsoluteX;
 };
 
-void CPU6502::AM_ABY() {
-  if (pc & 0xff == 0xff) pageBoundaryCrossed = 1;
-  currentAddress = (read(pc) | (read(pc + 1) << 8)) + y;
-  currentValue = read(currentAddress);
+void CPU6502::AM_ABY(bool fetch) {
+  uint16_t base = read(pc) | (read(pc + 1) << 8);
+  currentAddress = base + y;
+  pageBoundaryCrossed = (base & 0xff00) != (currentAddress & 0xff00);
+  if (fetch) currentValue = read(currentAddress);
   pc += 2;
   addressingMode = AbsoluteY;
 };
 
-void CPU6502::AM_IND() {
-  if (pc & 0xff == 0xff) pageBoundaryCrossed = 1;
-  currentAddress = read(pc) | (read(pc + 1) << 8);
-  currentValue = read(currentAddress);
+// Only JMP uses this. The pointer's high byte is fetched without carrying
+// into the page, so JMP ($xxFF) takes it from $xx00.
+void CPU6502::AM_IND(bool fetch) {
+  uint16_t pointer = read(pc) | (read(pc + 1) << 8);
+  currentAddress = read(pointer) | (read((pointer & 0xff00) | ((pointer + 1) & 0xff)) << 8);
+  if (fetch) currentValue = read(currentAddress);
   pc += 2;
   addressingMode = Indirect;
 };
 
-void CPU6502::AM_INX() {
-  if (pc & 0xff == 0xff) pageBoundaryCrossed = 1;
-  currentAddress = read((uint8_t)(read(pc) + x)) | (read((uint8_t)(read(pc) + x + 1)) << 8);
-  currentValue = read(currentAddress);
+void CPU6502::AM_INX(bool fetch) {
+  uint8_t pointer = read(pc) + x;
+  currentAddress = readRAM(pointer) | (readRAM((uint8_t)(pointer + 1)) << 8);
+  if (fetch) currentValue = read(currentAddress);
   pc++;
   addressingMode = IndirectX;
 };
 
-void CPU6502::AM_INY() {
-  if (pc & 0xff == 0xff) pageBoundaryCrossed = 1;
-  currentAddress = (read(read(pc)) | (read(read(pc) + 1) << 8)) + y;
-  currentValue = read(currentAddress);
+void CPU6502::AM_INY(bool fetch) {
+  uint8_t pointer = read(pc);
+  uint16_t base = readRAM(pointer) | (readRAM((uint8_t)(pointer + 1)) << 8);
+  currentAddress = base + y;
+  pageBoundaryCrossed = (base & 0xff00) != (currentAddress & 0xff00);
+  if (fetch) currentValue = read(currentAddress);
   pc++;
   addressingMode = IndirectY;
 };
 
 // Instructions
 void CPU6502::I_ADC() {
-  uint8_t sum = a + currentValue + BIT_VALUE(p, CARRY_BIT);
-
-  ASSIGN_BIT(p, OVERFLOW_BIT, ((~(a ^ currentValue)) & (a ^ sum) & 0x80) >> 7);
-  ASSIGN_BIT(p, CARRY_BIT, sum < a);
-  ASSIGN_BIT(p, NEGATIVE_BIT, (sum & 0x80) >> 7);
-  ASSIGN_BIT(p, ZERO_BIT, sum == 0);
-
-  a = sum;
+  addWithCarry(currentValue);
 
   switch (addressingMode) {
     case Immediate: cycles += 2; break;
@@ -161,10 +191,8 @@ void CPU6502::I_AND() {
 };
 
 void CPU6502::I_ASL() {
-  // Clear the status register and set the carry bit to bit 7
-  p = currentValue & 0x80;
-
   uint8_t newValue = currentValue << 1;
+  ASSIGN_BIT(p, CARRY_BIT, BIT_VALUE(currentValue, 7));
   ASSIGN_BIT(p, NEGATIVE_BIT, (newValue & 0x80) >> 7);
   ASSIGN_BIT(p, ZERO_BIT, newValue == 0);
 
@@ -188,7 +216,7 @@ void CPU6502::I_BCC() {
   if (BIT_VALUE(p, CARRY_BIT) == 0) {
     uint16_t oldPc = pc;
     pc += (int8_t)currentValue;
-    cycles += (pc & 0xff00 != oldPc & 0xff00) ? 2 : 1;
+    cycles += ((pc & 0xff00) != (oldPc & 0xff00)) ? 2 : 1;
   }
   cycles += 2;
 };
@@ -197,26 +225,25 @@ void CPU6502::I_BCS() {
   if (BIT_VALUE(p, CARRY_BIT)) {
     uint16_t oldPc = pc;
     pc += (int8_t)currentValue;
-    cycles += (pc & 0xff00 != oldPc & 0xff00) ? 2 : 1;
+    cycles += ((pc & 0xff00) != (oldPc & 0xff00)) ? 2 : 1;
   }
   cycles += 2;
 };
 
 void CPU6502::I_BEQ() {
-  if (BIT_VALUE(p, ZERO_BIT) == 0) {
+  if (BIT_VALUE(p, ZERO_BIT)) {
     uint16_t oldPc = pc;
     pc += (int8_t)currentValue;
-    cycles += (pc & 0xff00 != oldPc & 0xff00) ? 2 : 1;
+    cycles += ((pc & 0xff00) != (oldPc & 0xff00)) ? 2 : 1;
   }
   cycles += 2;
 };
 
 void CPU6502::I_BIT() {
-  uint8_t res = a & currentValue;
-
-  ASSIGN_BIT(p, NEGATIVE_BIT, (res & 0x80) >> 7);
-  ASSIGN_BIT(p, ZERO_BIT, res == 0);
-  ASSIGN_BIT(p, OVERFLOW_BIT, (res & 0x40) >> 6);
+  // N and V come straight from the operand, only Z depends on A
+  ASSIGN_BIT(p, NEGATIVE_BIT, BIT_VALUE(currentValue, 7));
+  ASSIGN_BIT(p, OVERFLOW_BIT, BIT_VALUE(currentValue, 6));
+  ASSIGN_BIT(p, ZERO_BIT, (a & currentValue) == 0);
 
   switch (addressingMode) {
     case ZeroPage: cycles += 3; break;
@@ -229,16 +256,16 @@ void CPU6502::I_BMI() {
   if (BIT_VALUE(p, NEGATIVE_BIT)) {
     uint16_t oldPc = pc;
     pc += (int8_t)currentValue;
-    cycles += (pc & 0xff00 != oldPc & 0xff00) ? 2 : 1;
+    cycles += ((pc & 0xff00) != (oldPc & 0xff00)) ? 2 : 1;
   }
   cycles += 2;
 };
 
 void CPU6502::I_BNE() {
-  if (BIT_VALUE(p, ZERO_BIT)) {
+  if (BIT_VALUE(p, ZERO_BIT) == 0) {
     uint16_t oldPc = pc;
     pc += (int8_t)currentValue;
-    cycles += (pc & 0xff00 != oldPc & 0xff00) ? 2 : 1;
+    cycles += ((pc & 0xff00) != (oldPc & 0xff00)) ? 2 : 1;
   }
   cycles += 2;
 };
@@ -247,13 +274,19 @@ void CPU6502::I_BPL() {
   if (BIT_VALUE(p, NEGATIVE_BIT) == 0) {
     uint16_t oldPc = pc;
     pc += (int8_t)currentValue;
-    cycles += (pc & 0xff00 != oldPc & 0xff00) ? 2 : 1;
+    cycles += ((pc & 0xff00) != (oldPc & 0xff00)) ? 2 : 1;
   }
   cycles += 2;
 };
 
 void CPU6502::I_BRK() {
-  SET_BIT(p, BREAK_BIT);
+  // BRK skips a padding byte and pushes its status with the B flag set
+  pc++;
+  push(pc >> 8);
+  push(pc & 0xff);
+  push(p | 0x20 | STATUS_BREAK);
+  SET_BIT(p, INTERRUPT_BIT);
+  pc = read(0xfffe) | (read(0xffff) << 8);
   cycles += 7;
 };
 
@@ -261,7 +294,7 @@ void CPU6502::I_BVC() {
   if (BIT_VALUE(p, OVERFLOW_BIT) == 0) {
     uint16_t oldPc = pc;
     pc += (int8_t)currentValue;
-    cycles += (pc & 0xff00 != oldPc & 0xff00) ? 2 : 1;
+    cycles += ((pc & 0xff00) != (oldPc & 0xff00)) ? 2 : 1;
   }
   cycles += 2;
 };
@@ -270,7 +303,7 @@ void CPU6502::I_BVS() {
   if (BIT_VALUE(p, OVERFLOW_BIT)) {
     uint16_t oldPc = pc;
     pc += (int8_t)currentValue;
-    cycles += (pc & 0xff00 != oldPc & 0xff00) ? 2 : 1;
+    cycles += ((pc & 0xff00) != (oldPc & 0xff00)) ? 2 : 1;
   }
   cycles += 2;
 };
@@ -296,9 +329,7 @@ void CPU6502::I_CLV() {
 };
 
 void CPU6502::I_CMP() {
-  ASSIGN_BIT(p, CARRY_BIT, a > currentValue);
-  ASSIGN_BIT(p, ZERO_BIT, a == currentValue);
-  ASSIGN_BIT(p, NEGATIVE_BIT, (currentValue & 0x80) >> 7);
+  compare(a, currentValue);
 
   switch (addressingMode) {
     case Immediate: cycles += 2; break;
@@ -326,9 +357,7 @@ void CPU6502::I_CMP() {
 };
 
 void CPU6502::I_CPX() {
-  ASSIGN_BIT(p, CARRY_BIT, x > currentValue);
-  ASSIGN_BIT(p, ZERO_BIT, x == currentValue);
-  ASSIGN_BIT(p, NEGATIVE_BIT, (currentValue & 0x80) >> 7);
+  compare(x, currentValue);
 
   switch (addressingMode) {
     case Immediate: cycles += 2; break;
@@ -339,9 +368,7 @@ void CPU6502::I_CPX() {
 };
 
 void CPU6502::I_CPY() {
-  ASSIGN_BIT(p, CARRY_BIT, y > currentValue);
-  ASSIGN_BIT(p, ZERO_BIT, y == currentValue);
-  ASSIGN_BIT(p, NEGATIVE_BIT, (currentValue & 0x80) >> 7);
+  compare(y, currentValue);
 
   switch (addressingMode) {
     case Immediate: cycles += 2; break;
@@ -456,7 +483,9 @@ void CPU6502::I_JMP() {
 };
 
 void CPU6502::I_JSR() {
-  push(pc - 1);
+  uint16_t returnAddress = pc - 1;
+  push(returnAddress >> 8);
+  push(returnAddress & 0xff);
   pc = currentAddress;
   cycles += 6;
 };
@@ -546,19 +575,31 @@ void CPU6502::I_LSR() {
   }
 
   switch (addressingMode) {
+    case Accumulator: cycles += 2; break;
+    case ZeroPage: cycles += 5; break;
+    case ZeroPageX: cycles += 6; break;
+    case Absolute: cycles += 6; break;
+    case AbsoluteX: cycles += 7; break;
+    default: break;
+  }
+};
+
+void CPU6502::I_NOP() {
+  switch (addressingMode) {
+    case Implicit: cycles += 2; break;
     case Immediate: cycles += 2; break;
     case ZeroPage: cycles += 3; break;
     case ZeroPageX: cycles += 4; break;
     case Absolute: cycles += 4; break;
-    case AbsoluteX: cycles += 4; break;
+    case AbsoluteX: {
+      if (pageBoundaryCrossed) cycles++;
+      cycles += 4;
+      break;
+    }
     default: break;
   }
 };
 
-void CPU6502::I_NOP() {
-  cycles += 2;
-};
-
 void CPU6502::I_ORA() {
   a |= currentValue;
 
@@ -596,17 +637,20 @@ void CPU6502::I_PHA() {
 };
 
 void CPU6502::I_PHP() {
-  push(p);
+  // Like BRK, PHP pushes the status with the B flag set
+  push(p | 0x20 | STATUS_BREAK);
   cycles += 3;
 };
 
 void CPU6502::I_PLA() {
   a = pop();
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
   cycles += 4;
 };
 
 void CPU6502::I_PLP() {
-  p = pop();
+  p = (pop() & ~STATUS_BREAK) | 0x20;
   cycles += 4;
 };
 
@@ -657,26 +701,22 @@ void CPU6502::I_ROR() {
 };
 
 void CPU6502::I_RTI() {
-  p = pop();
+  p = (pop() & ~STATUS_BREAK) | 0x20;
   pc = pop();
+  pc |= pop() << 8;
   cycles += 6;
 };
 
 void CPU6502::I_RTS() {
-  p = pop();
   pc = pop();
+  pc |= pop() << 8;
+  pc++;
   cycles += 6;
 };
 
 void CPU6502::I_SBC() {
-  uint8_t sum = a - currentValue - BIT_VALUE(p, CARRY_BIT);
-
-  ASSIGN_BIT(p, OVERFLOW_BIT, ((~(a ^ currentValue)) & (a ^ sum) & 0x80) >> 7);
-  ASSIGN_BIT(p, CARRY_BIT, sum > a);
-  ASSIGN_BIT(p, NEGATIVE_BIT, (sum & 0x80) >> 7);
-  ASSIGN_BIT(p, ZERO_BIT, sum == 0);
-
-  a = sum;
+  // A - M - !C is A + ~M + C
+  addWithCarry(~currentValue);
 
   switch (addressingMode) {
     case Immediate: cycles += 2; break;
@@ -745,7 +785,7 @@ void CPU6502::I_STX() {
 };
 
 void CPU6502::I_STY() {
-  write(currentAddress, x);
+  write(currentAddress, y);
 
   switch (addressingMode) {
     case ZeroPage: cycles += 3; break;
@@ -795,12 +835,356 @@ void CPU6502::I_TYA() {
   cycles += 2;
 };
 
+// Undocumented Instructions
+void CPU6502::I_ALR() {
+  a &= currentValue;
+  ASSIGN_BIT(p, CARRY_BIT, BIT_VALUE(a, 0));
+  a >>= 1;
+
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+  cycles += 2;
+};
+
+void CPU6502::I_ANC() {
+  a &= currentValue;
+
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+  ASSIGN_BIT(p, CARRY_BIT, (a & 0x80) >> 7);
+  cycles += 2;
+};
+
+void CPU6502::I_ANE() {
+  // The "magic" constant varies between chips, $EE is the common value
+  a = (a | 0xee) & x & currentValue;
+
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+  cycles += 2;
+};
+
+void CPU6502::I_ARR() {
+  a = (BIT_VALUE(p, CARRY_BIT) << 7) | ((a & currentValue) >> 1);
+
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+  ASSIGN_BIT(p, CARRY_BIT, BIT_VALUE(a, 6));
+  ASSIGN_BIT(p, OVERFLOW_BIT, BIT_VALUE(a, 6) ^ BIT_VALUE(a, 5));
+  cycles += 2;
+};
+
+void CPU6502::I_DCP() {
+  uint8_t res = currentValue - 1;
+  write(currentAddress, res);
+  compare(a, res);
+
+  switch (addressingMode) {
+    case ZeroPage: cycles += 5; break;
+    case ZeroPageX: cycles += 6; break;
+    case Absolute: cycles += 6; break;
+    case AbsoluteX: cycles += 7; break;
+    case AbsoluteY: cycles += 7; break;
+    case IndirectX: cycles += 8; break;
+    case IndirectY: cycles += 8; break;
+    default: break;
+  }
+};
+
+void CPU6502::I_ISC() {
+  uint8_t res = currentValue + 1;
+  write(currentAddress, res);
+  addWithCarry(~res);
+
+  switch (addressingMode) {
+    case ZeroPage: cycles += 5; break;
+    case ZeroPageX: cycles += 6; break;
+    case Absolute: cycles += 6; break;
+    case AbsoluteX: cycles += 7; break;
+    case AbsoluteY: cycles += 7; break;
+    case IndirectX: cycles += 8; break;
+    case IndirectY: cycles += 8; break;
+    default: break;
+  }
+};
+
+void CPU6502::I_JAM() {
+  // The CPU locks up; refetching the same opcode forever models the halt
+  pc--;
+  cycles += 2;
+};
+
+void CPU6502::I_LAS() {
+  a = x = sp = currentValue & sp;
+
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+
+  if (pageBoundaryCrossed) cycles++;
+  cycles += 4;
+};
+
+void CPU6502::I_LAX() {
+  a = x = currentValue;
+
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+
+  switch (addressingMode) {
+    case ZeroPage: cycles += 3; break;
+    case ZeroPageY: cycles += 4; break;
+    case Absolute: cycles += 4; break;
+    case AbsoluteY: {
+      if (pageBoundaryCrossed) cycles++;
+      cycles += 4;
+      break;
+    }
+    case IndirectX: cycles += 6; break;
+    case IndirectY: {
+      if (pageBoundaryCrossed) cycles++;
+      cycles += 5;
+      break;
+    }
+    default: break;
+  }
+};
+
+void CPU6502::I_LXA() {
+  a = x = (a | 0xee) & currentValue;
+
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+  cycles += 2;
+};
+
+void CPU6502::I_RLA() {
+  uint8_t res = (currentValue << 1) | BIT_VALUE(p, CARRY_BIT);
+  write(currentAddress, res);
+
+  a &= res;
+  ASSIGN_BIT(p, CARRY_BIT, BIT_VALUE(currentValue, 7));
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+
+  switch (addressingMode) {
+    case ZeroPage: cycles += 5; break;
+    case ZeroPageX: cycles += 6; break;
+    case Absolute: cycles += 6; break;
+    case AbsoluteX: cycles += 7; break;
+    case AbsoluteY: cycles += 7; break;
+    case IndirectX: cycles += 8; break;
+    case IndirectY: cycles += 8; break;
+    default: break;
+  }
+};
+
+void CPU6502::I_RRA() {
+  uint8_t res = (BIT_VALUE(p, CARRY_BIT) << 7) | (currentValue >> 1);
+  write(currentAddress, res);
+
+  ASSIGN_BIT(p, CARRY_BIT, BIT_VALUE(currentValue, 0));
+  addWithCarry(res);
+
+  switch (addressingMode) {
+    case ZeroPage: cycles += 5; break;
+    case ZeroPageX: cycles += 6; break;
+    case Absolute: cycles += 6; break;
+    case AbsoluteX: cycles += 7; break;
+    case AbsoluteY: cycles += 7; break;
+    case IndirectX: cycles += 8; break;
+    case IndirectY: cycles += 8; break;
+    default: break;
+  }
+};
+
+void CPU6502::I_SAX() {
+  write(currentAddress, a & x);
+
+  switch (addressingMode) {
+    case ZeroPage: cycles += 3; break;
+    case ZeroPageY: cycles += 4; break;
+    case Absolute: cycles += 4; break;
+    case IndirectX: cycles += 6; break;
+    default: break;
+  }
+};
+
+void CPU6502::I_SBX() {
+  uint8_t ax = a & x;
+  x = ax - currentValue;
+
+  ASSIGN_BIT(p, CARRY_BIT, ax >= currentValue);
+  ASSIGN_BIT(p, ZERO_BIT, x == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (x & 0x80) >> 7);
+  cycles += 2;
+};
+
+void CPU6502::I_SHA() {
+  writeUnstable(a & x, y);
+
+  switch (addressingMode) {
+    case AbsoluteY: cycles += 5; break;
+    case IndirectY: cycles += 6; break;
+    default: break;
+  }
+};
+
+void CPU6502::I_SHX() {
+  writeUnstable(x, y);
+  cycles += 5;
+};
+
+void CPU6502::I_SHY() {
+  writeUnstable(y, x);
+  cycles += 5;
+};
+
+void CPU6502::I_SLO() {
+  uint8_t res = currentValue << 1;
+  write(currentAddress, res);
+
+  a |= res;
+  ASSIGN_BIT(p, CARRY_BIT, BIT_VALUE(currentValue, 7));
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+
+  switch (addressingMode) {
+    case ZeroPage: cycles += 5; break;
+    case ZeroPageX: cycles += 6; break;
+    case Absolute: cycles += 6; break;
+    case AbsoluteX: cycles += 7; break;
+    case AbsoluteY: cycles += 7; break;
+    case IndirectX: cycles += 8; break;
+    case IndirectY: cycles += 8; break;
+    default: break;
+  }
+};
+
+void CPU6502::I_SRE() {
+  uint8_t res = currentValue >> 1;
+  write(currentAddress, res);
+
+  a ^= res;
+  ASSIGN_BIT(p, CARRY_BIT, BIT_VALUE(currentValue, 0));
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+
+  switch (addressingMode) {
+    case ZeroPage: cycles += 5; break;
+    case ZeroPageX: cycles += 6; break;
+    case Absolute: cycles += 6; break;
+    case AbsoluteX: cycles += 7; break;
+    case AbsoluteY: cycles += 7; break;
+    case IndirectX: cycles += 8; break;
+    case IndirectY: cycles += 8; break;
+    default: break;
+  }
+};
+
+void CPU6502::I_TAS() {
+  sp = a & x;
+  writeUnstable(sp, y);
+  cycles += 5;
+};
+
+// Shared ALU helpers
+void CPU6502::addWithCarry(uint8_t value) {
+  uint16_t sum = a + value + BIT_VALUE(p, CARRY_BIT);
+
+  ASSIGN_BIT(p, OVERFLOW_BIT, ((~(a ^ value)) & (a ^ sum) & 0x80) >> 7);
+  ASSIGN_BIT(p, CARRY_BIT, sum > 0xff);
+
+  a = sum;
+  ASSIGN_BIT(p, ZERO_BIT, a == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (a & 0x80) >> 7);
+};
+
+void CPU6502::compare(uint8_t reg, uint8_t value) {
+  uint8_t res = reg - value;
+
+  ASSIGN_BIT(p, CARRY_BIT, reg >= value);
+  ASSIGN_BIT(p, ZERO_BIT, res == 0);
+  ASSIGN_BIT(p, NEGATIVE_BIT, (res & 0x80) >> 7);
+};
+
+// SHA/SHX/SHY/TAS store `value & (high byte of the base address + 1)`. When
+// the indexing crosses a page the stored value also replaces the high byte
+// of the target address.
+void CPU6502::writeUnstable(uint8_t value, uint8_t index) {
+  value &= ((currentAddress - index) >> 8) + 1;
+  uint16_t address = pageBoundaryCrossed
+    ? (value << 8) | (currentAddress & 0xff)
+    : currentAddress;
+  write(address, value);
+};
+
 // High Level CPU Control
-void CPU6502::step() {
+void CPU6502::reset() {
+  sp = 0xfd;
+  p = 0x24;
+  pc = read(0xfffc) | (read(0xfffd) << 8);
+  cycles = 7;
+  totalCycles += cycles;
+};
+
+void CPU6502::nmi() {
+  push(pc >> 8);
+  push(pc & 0xff);
+  push((p | 0x20) & ~STATUS_BREAK);
+  SET_BIT(p, INTERRUPT_BIT);
+  pc = read(0xfffa) | (read(0xfffb) << 8);
+  cycles = 7;
+  totalCycles += cycles;
+};
+
+HOT_CODE void CPU6502::step() {
+#ifdef CPU_DEBUG
+  // Stopped before the instruction, so no time passes
+  if (Debugger::active && (*Debugger::active).breakAt(this)) {
+    cycles = 0;
+    return;
+  }
+#endif
+
+#ifdef CPU_TRACE
+  if (trace) traceInstruction();
+#endif
+
+  uint16_t start = pc;
   cycles = 0;
   pageBoundaryCrossed = 0;
   uint8_t opcode = read(pc++);
+  execute(opcode);
+  totalCycles += cycles;
+  CPUProfile::instruction(start, opcode, cycles, pageBoundaryCrossed, pc);
+};
+
+#ifdef CPU_TRACE
+TraceRing* CPU6502::trace = 0;
+
+// Read without side effects; I/O pages read as 0
+uint8_t CPU6502::peek(uint16_t address) {
+  uint8_t* page = readPages[address >> 8];
+  return page ? page[address & 0xff] : 0;
+}
 
+void CPU6502::traceInstruction() {
+  TraceRecord record;
+  record.pc = pc;
+  record.opcode = peek(pc);
+  record.operands[0] = peek(pc + 1);
+  record.operands[1] = peek(pc + 2);
+  record.a = a;
+  record.x = x;
+  record.y = y;
+  record.p = p;
+  record.sp = sp;
+  memcpy(record.cycle, &totalCycles, sizeof(record.cycle));
+  (*trace).write(record);
+}
+#endif
+
+void CPU6502::execute(uint8_t opcode) {
   switch (opcode) {
     // ADC
     case 0x69: { AM_IMM(); return I_ADC(); }
@@ -835,6 +1219,9 @@ void CPU6502::step() {
     // BCS
     case 0xB0: { AM_REL(); return I_BCS(); }
 
+    // BEQ
+    case 0xF0: { AM_REL(); return I_BEQ(); }
+
     // BIT
     case 0x24: { AM_ZP(); return I_BIT(); }
     case 0x2C: { AM_ABS(); return I_BIT(); }
@@ -860,6 +1247,9 @@ void CPU6502::step() {
     // CLC
     case 0x18: { AM_IMP(); return I_CLC(); }
 
+    // CLD
+    case 0xD8: { AM_IMP(); return I_CLD(); }
+
     // CLI
     case 0x58: { AM_IMP(); return I_CLI(); }
 
@@ -921,11 +1311,11 @@ void CPU6502::step() {
     case 0xC8: { AM_IMP(); return I_INY(); }
 
     // JMP
-    case 0x4C: { AM_ABS(); return I_JMP(); }
-    case 0x6C: { AM_IND(); return I_JMP(); }
+    case 0x4C: { AM_ABS(false); return I_JMP(); }
+    case 0x6C: { AM_IND(false); return I_JMP(); }
 
     // JSR
-    case 0x20: { AM_ABS(); return I_JSR(); }
+    case 0x20: { AM_ABS(false); return I_JSR(); }
 
     // LDA
     case 0xA9: { AM_IMM(); return I_LDA(); }
@@ -1023,23 +1413,23 @@ void CPU6502::step() {
     case 0x78: { AM_IMP(); return I_SEI(); }
 
     // STA
-    case 0x85: { AM_ZP(); return I_STA(); }
-    case 0x95: { AM_ZPX(); return I_STA(); }
-    case 0x8D: { AM_ABS(); return I_STA(); }
-    case 0x9D: { AM_ABX(); return I_STA(); }
-    case 0x99: { AM_ABY(); return I_STA(); }
-    case 0x81: { AM_INX(); return I_STA(); }
-    case 0x91: { AM_INY(); return I_STA(); }
+    case 0x85: { AM_ZP(false); return I_STA(); }
+    case 0x95: { AM_ZPX(false); return I_STA(); }
+    case 0x8D: { AM_ABS(false); return I_STA(); }
+    case 0x9D: { AM_ABX(false); return I_STA(); }
+    case 0x99: { AM_ABY(false); return I_STA(); }
+    case 0x81: { AM_INX(false); return I_STA(); }
+    case 0x91: { AM_INY(false); return I_STA(); }
 
     // STX
-    case 0x86: { AM_ZP(); return I_STX(); }
-    case 0x96: { AM_ZPY(); return I_STX(); }
-    case 0x8E: { AM_ABS(); return I_STX(); }
+    case 0x86: { AM_ZP(false); return I_STX(); }
+    case 0x96: { AM_ZPY(false); return I_STX(); }
+    case 0x8E: { AM_ABS(false); return I_STX(); }
 
     // STY
-    case 0x84: { AM_ZP(); return I_STY(); }
-    case 0x94: { AM_ZPX(); return I_STY(); }
-    case 0x8C: { AM_ABS(); return I_STY(); }
+    case 0x84: { AM_ZP(false); return I_STY(); }
+    case 0x94: { AM_ZPX(false); return I_STY(); }
+    case 0x8C: { AM_ABS(false); return I_STY(); }
 
     // TAX
     case 0xAA: { AM_IMP(); return I_TAX(); }
@@ -1059,42 +1449,187 @@ void CPU6502::step() {
     // TYA
     case 0x98: { AM_IMP(); return I_TYA(); }
 
-    default: {
-      break;
-    }
+    // Undocumented opcodes
+
+    // ALR
+    case 0x4B: { AM_IMM(); return I_ALR(); }
+
+    // ANC
+    case 0x0B: { AM_IMM(); return I_ANC(); }
+    case 0x2B: { AM_IMM(); return I_ANC(); }
+
+    // ANE
+    case 0x8B: { AM_IMM(); return I_ANE(); }
+
+    // ARR
+    case 0x6B: { AM_IMM(); return I_ARR(); }
+
+    // DCP
+    case 0xC3: { AM_INX(); return I_DCP(); }
+    case 0xC7: { AM_ZP(); return I_DCP(); }
+    case 0xCF: { AM_ABS(); return I_DCP(); }
+    case 0xD3: { AM_INY(); return I_DCP(); }
+    case 0xD7: { AM_ZPX(); return I_DCP(); }
+    case 0xDB: { AM_ABY(); return I_DCP(); }
+    case 0xDF: { AM_ABX(); return I_DCP(); }
+
+    // ISC
+    case 0xE3: { AM_INX(); return I_ISC(); }
+    case 0xE7: { AM_ZP(); return I_ISC(); }
+    case 0xEF: { AM_ABS(); return I_ISC(); }
+    case 0xF3: { AM_INY(); return I_ISC(); }
+    case 0xF7: { AM_ZPX(); return I_ISC(); }
+    case 0xFB: { AM_ABY(); return I_ISC(); }
+    case 0xFF: { AM_ABX(); return I_ISC(); }
+
+    // JAM
+    case 0x02: { AM_IMP(); return I_JAM(); }
+    case 0x12: { AM_IMP(); return I_JAM(); }
+    case 0x22: { AM_IMP(); return I_JAM(); }
+    case 0x32: { AM_IMP(); return I_JAM(); }
+    case 0x42: { AM_IMP(); return I_JAM(); }
+    case 0x52: { AM_IMP(); return I_JAM(); }
+    case 0x62: { AM_IMP(); return I_JAM(); }
+    case 0x72: { AM_IMP(); return I_JAM(); }
+    case 0x92: { AM_IMP(); return I_JAM(); }
+    case 0xB2: { AM_IMP(); return I_JAM(); }
+    case 0xD2: { AM_IMP(); return I_JAM(); }
+    case 0xF2: { AM_IMP(); return I_JAM(); }
+
+    // LAS
+    case 0xBB: { AM_ABY(); return I_LAS(); }
+
+    // LAX
+    case 0xA3: { AM_INX(); return I_LAX(); }
+    case 0xA7: { AM_ZP(); return I_LAX(); }
+    case 0xAF: { AM_ABS(); return I_LAX(); }
+    case 0xB3: { AM_INY(); return I_LAX(); }
+    case 0xB7: { AM_ZPY(); return I_LAX(); }
+    case 0xBF: { AM_ABY(); return I_LAX(); }
+
+    // LXA
+    case 0xAB: { AM_IMM(); return I_LXA(); }
+
+    // NOP
+    case 0x04: { AM_ZP(); return I_NOP(); }
+    case 0x0C: { AM_ABS(); return I_NOP(); }
+    case 0x14: { AM_ZPX(); return I_NOP(); }
+    case 0x1A: { AM_IMP(); return I_NOP(); }
+    case 0x1C: { AM_ABX(); return I_NOP(); }
+    case 0x34: { AM_ZPX(); return I_NOP(); }
+    case 0x3A: { AM_IMP(); return I_NOP(); }
+    case 0x3C: { AM_ABX(); return I_NOP(); }
+    case 0x44: { AM_ZP(); return I_NOP(); }
+    case 0x54: { AM_ZPX(); return I_NOP(); }
+    case 0x5A: { AM_IMP(); return I_NOP(); }
+    case 0x5C: { AM_ABX(); return I_NOP(); }
+    case 0x64: { AM_ZP(); return I_NOP(); }
+    case 0x74: { AM_ZPX(); return I_NOP(); }
+    case 0x7A: { AM_IMP(); return I_NOP(); }
+    case 0x7C: { AM_ABX(); return I_NOP(); }
+    case 0x80: { AM_IMM(); return I_NOP(); }
+    case 0x82: { AM_IMM(); return I_NOP(); }
+    case 0x89: { AM_IMM(); return I_NOP(); }
+    case 0xC2: { AM_IMM(); return I_NOP(); }
+    case 0xD4: { AM_ZPX(); return I_NOP(); }
+    case 0xDA: { AM_IMP(); return I_NOP(); }
+    case 0xDC: { AM_ABX(); return I_NOP(); }
+    case 0xE2: { AM_IMM(); return I_NOP(); }
+    case 0xF4: { AM_ZPX(); return I_NOP(); }
+    case 0xFA: { AM_IMP(); return I_NOP(); }
+    case 0xFC: { AM_ABX(); return I_NOP(); }
+
+    // RLA
+    case 0x23: { AM_INX(); return I_RLA(); }
+    case 0x27: { AM_ZP(); return I_RLA(); }
+    case 0x2F: { AM_ABS(); return I_RLA(); }
+    case 0x33: { AM_INY(); return I_RLA(); }
+    case 0x37: { AM_ZPX(); return I_RLA(); }
+    case 0x3B: { AM_ABY(); return I_RLA(); }
+    case 0x3F: { AM_ABX(); return I_RLA(); }
+
+    // RRA
+    case 0x63: { AM_INX(); return I_RRA(); }
+    case 0x67: { AM_ZP(); return I_RRA(); }
+    case 0x6F: { AM_ABS(); return I_RRA(); }
+    case 0x73: { AM_INY(); return I_RRA(); }
+    case 0x77: { AM_ZPX(); return I_RRA(); }
+    case 0x7B: { AM_ABY(); return I_RRA(); }
+    case 0x7F: { AM_ABX(); return I_RRA(); }
+
+    // SAX
+    case 0x83: { AM_INX(false); return I_SAX(); }
+    case 0x87: { AM_ZP(false); return I_SAX(); }
+    case 0x8F: { AM_ABS(false); return I_SAX(); }
+    case 0x97: { AM_ZPY(false); return I_SAX(); }
+
+    // SBX
+    case 0xCB: { AM_IMM(); return I_SBX(); }
+
+    // SHA
+    case 0x93: { AM_INY(false); return I_SHA(); }
+    case 0x9F: { AM_ABY(false); return I_SHA(); }
+
+    // SHX
+    case 0x9E: { AM_ABY(false); return I_SHX(); }
+
+    // SHY
+    case 0x9C: { AM_ABX(false); return I_SHY(); }
+
+    // SLO
+    case 0x03: { AM_INX(); return I_SLO(); }
+    case 0x07: { AM_ZP(); return I_SLO(); }
+    case 0x0F: { AM_ABS(); return I_SLO(); }
+    case 0x13: { AM_INY(); return I_SLO(); }
+    case 0x17: { AM_ZPX(); return I_SLO(); }
+    case 0x1B: { AM_ABY(); return I_SLO(); }
+    case 0x1F: { AM_ABX(); return I_SLO(); }
+
+    // SRE
+    case 0x43: { AM_INX(); return I_SRE(); }
+    case 0x47: { AM_ZP(); return I_SRE(); }
+    case 0x4F: { AM_ABS(); return I_SRE(); }
+    case 0x53: { AM_INY(); return I_SRE(); }
+    case 0x57: { AM_ZPX(); return I_SRE(); }
+    case 0x5B: { AM_ABY(); return I_SRE(); }
+    case 0x5F: { AM_ABX(); return I_SRE(); }
+
+    // TAS
+    case 0x9B: { AM_ABY(false); return I_TAS(); }
+
+    // USBC
+    case 0xEB: { AM_IMM(); return I_SBC(); }
   }
 };
 
 void CPU6502::connectToBus(Bus* b) {
   bus = b;
+  readPages = (*b).readPages;
+  writePages = (*b).writePages;
+  ram = (*b).ram;
 };
 
-void CPU6502::write(uint16_t address, uint8_t value) {
-  (*bus).write(address, value);
+HOT_CODE void CPU6502::write(uint16_t address, uint8_t value) {
+  CPUProfile::write(address);
+  uint8_t* page = writePages[address >> 8];
+  if (page) {
+    page[address & 0xff] = value;
+  } else {
+    (*bus).write(address, value);
+  }
 };
 
-uint8_t CPU6502::read(uint16_t address) {
+HOT_CODE uint8_t CPU6502::read(uint16_t address) {
+  CPUProfile::read(address);
+  uint8_t* page = readPages[address >> 8];
+  if (page) return page[address & 0xff];
   return (*bus).read(address);
 };
 
 void CPU6502::push(uint8_t value) {
-  (*bus).write((1 << 8) | sp--, value);
+  writeRAM((1 << 8) | sp--, value);
 };
 
 uint8_t CPU6502::pop() {
-  return (*bus).read(((1 << 8) | sp++) + 1);
-};
-
-void CPU6502::printCPUState() {
-  printf("A=%hhx X=%hhx Y=%hhx\n", a, x, y);
-  printf(
-    "N=%hhx V=%hhx B=%hhx D=%hhx I=%hhx Z=%hhx C=%hhx\n",
-    BIT_VALUE(p, NEGATIVE_BIT),
-    BIT_VALUE(p, OVERFLOW_BIT),
-    BIT_VALUE(p, BREAK_BIT),
-    BIT_VALUE(p, DECIMAL_BIT),
-    BIT_VALUE(p, INTERRUPT_BIT),
-    BIT_VALUE(p, ZERO_BIT),
-    BIT_VALUE(p, CARRY_BIT)
-  );
-}
+  return readRAM((1 << 8) | ++sp);
+};
@@ -2,6 +2,10 @@
 
 #include <stdint.h>
 
+#ifdef CPU_TRACE
+#include "Trace.h"
+#endif
+
 #define NEGATIVE_BIT   7
 #define OVERFLOW_BIT   6
 #define BREAK_BIT      4
@@ -16,14 +20,14 @@
 #define STATUS_DECIMAL    (1 << DECIMAL_BIT)
 #define STATUS_INTERRUPT  (1 << INTERRUPT_BIT)
 #define STATUS_ZERO       (1 << ZERO_BIT)
-#define STATUS_CARRY      CARRY_BIT
+#define STATUS_CARRY      (1 << CARRY_BIT)
 
 #define BIT_VALUE(b,i) ((b & (1 << i)) >> i)
 #define SET_BIT(b,i) b |= (1 << i)
 #define CLEAR_BIT(b,i) b &= ~(1 << i)
 #define ASSIGN_BIT(b,i,v) if (v) { SET_BIT(b,i); } else { CLEAR_BIT(b,i); }
 
-enum AddressingMode {
+enum AddressingMode : uint8_t {
   Implicit,
   Accumulator,
   Immediate,
@@ -41,40 +45,76 @@ enum AddressingMode {
 
 class Bus;
 
-class CPU6502 {
+// Architectural state, kept in one plain block so savestates can copy it.
+// Ordered so there is no padding, which would otherwise end up in
+// savestates as whatever the stack or heap held.
+struct CPURegisters {
+  uint8_t a;   // Accumulator
+  uint8_t x;   // X
+  uint8_t y;   // Y
+  uint8_t sp;  // Stack Pointer
+  uint8_t p;   // Status Register
+  uint8_t cycles; // Cycles taken by the last step()
+  uint16_t pc; // Program Counter
+
+  uint64_t totalCycles; // Cycles taken since power on
+};
+
+static_assert(sizeof(CPURegisters) == 16, "CPURegisters must not have padding");
+
+// Everything the CPU touches per instruction lives in this object, and the
+// whole object fits in a single cache line. Keep cold state (debugging,
+// configuration) out of here so it stays that way.
+class alignas(64) CPU6502 : public CPURegisters {
+  public:
+    CPU6502();
+    ~CPU6502();
+
   private:
-    Bus* bus;
     uint8_t currentValue;
     uint16_t currentAddress;
-    uint8_t cycles;
     uint8_t pageBoundaryCrossed;
     AddressingMode addressingMode;
 
-  public:
-    CPU6502();
-    ~CPU6502();
+    // Direct pointers to each 256 byte page, owned by the bus. A null entry
+    // means the page isn't plain memory and the access goes through the bus.
+    uint8_t** readPages;
+    uint8_t** writePages;
+    Bus* bus;
+
+    // Internal RAM, which always holds the zero page and the stack
+    uint8_t* ram;
+
+    void execute(uint8_t opcode);
+
+#ifdef CPU_TRACE
+    uint8_t peek(uint16_t address);
+    void traceInstruction();
+#endif
 
-    uint8_t a;   // Accumulator
-    uint8_t x;   // X
-    uint8_t y;   // Y
-    uint16_t pc; // Program Counter
-    uint8_t sp;  // Stack Pointer
-    uint8_t p;   // Status Register
+    uint8_t readRAM(uint16_t address);
+    void writeRAM(uint16_t address, uint8_t value);
 
-    // Addressing Modes
+    void addWithCarry(uint8_t value);
+    void compare(uint8_t reg, uint8_t value);
+    void writeUnstable(uint8_t value, uint8_t index);
+
+  public:
+    // Addressing Modes. Stores and jumps pass fetch=false so the operand
+    // isn't read, which matters when the target is an I/O register.
     void AM_IMP();
     void AM_ACC();
     void AM_IMM();
-    void AM_ZP();
-    void AM_ZPX();
-    void AM_ZPY();
+    void AM_ZP(bool fetch = true);
+    void AM_ZPX(bool fetch = true);
+    void AM_ZPY(bool fetch = true);
     void AM_REL();
-    void AM_ABS();
-    void AM_ABX();
-    void AM_ABY();
-    void AM_IND();
-    void AM_INX();
-    void AM_INY();
+    void AM_ABS(bool fetch = true);
+    void AM_ABX(bool fetch = true);
+    void AM_ABY(bool fetch = true);
+    void AM_IND(bool fetch = true);
+    void AM_INX(bool fetch = true);
+    void AM_INY(bool fetch = true);
 
     // Instructions
     void I_ADC();
@@ -134,6 +174,28 @@ class CPU6502 {
     void I_TXS();
     void I_TYA();
 
+    // Undocumented Instructions
+    void I_ALR();
+    void I_ANC();
+    void I_ANE();
+    void I_ARR();
+    void I_DCP();
+    void I_ISC();
+    void I_JAM();
+    void I_LAS();
+    void I_LAX();
+    void I_LXA();
+    void I_RLA();
+    void I_RRA();
+    void I_SAX();
+    void I_SBX();
+    void I_SHA();
+    void I_SHX();
+    void I_SHY();
+    void I_SLO();
+    void I_SRE();
+    void I_TAS();
+
     // High Level CPU Control
     void connectToBus(Bus* b);
 
@@ -143,6 +205,15 @@ class CPU6502 {
     void push(uint8_t value);
     uint8_t pop();
 
+    void reset();
+    void nmi();
     void step();
-    void printCPUState();
+
+#ifdef CPU_TRACE
+    // Ring that step() records into while set. Kept out of the object so
+    // the CPU stays one cache line; every CPU in the process shares it.
+    static TraceRing* trace;
+#endif
 };
+
+static_assert(sizeof(CPU6502) == 64, "CPU6502 must fit in one cache line");
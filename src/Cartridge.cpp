@@ -0,0 +1,102 @@
+#include <string.h>
+#include "Cartridge.h"
+#include "PPU.h"
+#include "Footprint.h"
+
+Cartridge::Cartridge() : mapper(0), battery(0), prgRom(0), prgRomSize(0), chr(0), chrSize(0), chrIsRam(0), prgRam(prgRamData), nametableRam(0), ppu(0) {
+  mirroring = Horizontal;
+  memset(reserved, 0, sizeof(reserved));
+  memset(prgRamData, 0, sizeof(prgRamData));
+}
+
+Cartridge::~Cartridge() {
+  unload();
+}
+
+COLD_CODE bool Cartridge::load(const uint8_t* data, uint32_t size) {
+  if (size < INES_HEADER_SIZE || memcmp(data, "NES\x1a", 4) != 0) return false;
+
+  uint8_t flags6 = data[6];
+  uint8_t flags7 = data[7];
+  uint32_t prgSize = data[4] * PRG_BANK_SIZE;
+  uint32_t romChrSize = data[5] * CHR_BANK_SIZE;
+  uint32_t offset = INES_HEADER_SIZE + ((flags6 & 0x04) ? INES_TRAINER_SIZE : 0);
+
+  // Only NROM for now
+  uint8_t mapperNumber = (flags6 >> 4) | (flags7 & 0xf0);
+  if (mapperNumber != 0) return false;
+  if (prgSize == 0 || offset + prgSize + romChrSize > size) return false;
+
+  unload();
+
+  mapper = mapperNumber;
+  battery = (flags6 & 0x02) >> 1;
+
+  prgRomSize = prgSize;
+  prgRom = new uint8_t[prgRomSize];
+  memcpy(prgRom, data + offset, prgRomSize);
+
+  // Boards without CHR ROM have 8KB of CHR RAM instead
+  chrIsRam = romChrSize == 0;
+  chrSize = chrIsRam ? CHR_BANK_SIZE : romChrSize;
+  chr = new uint8_t[chrSize];
+  if (chrIsRam) {
+    memset(chr, 0, chrSize);
+  } else {
+    memcpy(chr, data + offset + prgRomSize, chrSize);
+  }
+
+  prgRam = prgRamData;
+  memset(prgRam, 0, PRG_RAM_SIZE);
+
+  if (flags6 & 0x08) {
+    nametableRam = new uint8_t[NAMETABLE_SIZE * 2];
+    memset(nametableRam, 0, NAMETABLE_SIZE * 2);
+    setMirroring(FourScreen);
+  } else {
+    setMirroring((flags6 & 0x01) ? Vertical : Horizontal);
+  }
+  return true;
+}
+
+COLD_CODE void Cartridge::unload() {
+  delete[] prgRom;
+  delete[] chr;
+  delete[] nametableRam;
+  prgRom = 0;
+  chr = 0;
+  nametableRam = 0;
+  prgRomSize = 0;
+  chrSize = 0;
+}
+
+void Cartridge::connectToPPU(PPU* p) {
+  ppu = p;
+}
+
+void Cartridge::setMirroring(Mirroring m) {
+  // Without the extra VRAM there are only two tables to choose from
+  if (m == FourScreen && !nametableRam) m = Vertical;
+  mirroring = m;
+  if (ppu) (*ppu).mapNametables();
+}
+
+uint8_t Cartridge::readPRG(uint16_t address) {
+  if (address >= 0x8000) return prgRom[(address - 0x8000) & (prgRomSize - 1)];
+  if (address >= 0x6000) return prgRam[address & (PRG_RAM_SIZE - 1)];
+  return 0;
+}
+
+void Cartridge::writePRG(uint16_t address, uint8_t value) {
+  if (address >= 0x6000 && address < 0x8000) {
+    prgRam[address & (PRG_RAM_SIZE - 1)] = value;
+  }
+}
+
+uint8_t Cartridge::readCHR(uint16_t address) {
+  return chr[address & (chrSize - 1)];
+}
+
+void Cartridge::writeCHR(uint16_t address, uint8_t value) {
+  if (chrIsRam) chr[address & (chrSize - 1)] = value;
+}
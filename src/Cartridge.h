@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+#define INES_HEADER_SIZE 16
+#define INES_TRAINER_SIZE 512
+#define PRG_BANK_SIZE 1024 * 16
+#define CHR_BANK_SIZE 1024 * 8
+#define PRG_RAM_SIZE 1024 * 8
+#define NAMETABLE_SIZE 1024
+
+class PPU;
+
+// How the PPU's four nametables at $2000-$2FFF map onto memory. The console
+// has two tables' worth of VRAM; four-screen boards add the other two.
+enum Mirroring : uint8_t {
+  Horizontal,       // $2000 = $2400, $2800 = $2C00
+  Vertical,         // $2000 = $2800, $2400 = $2C00
+  SingleScreenLow,  // All four are the first table
+  SingleScreenHigh, // All four are the second table
+  FourScreen
+};
+
+// Mapper state that can change while the game runs, kept in one plain
+// block so savestates can copy it
+struct CartridgeState {
+  Mirroring mirroring;
+  uint8_t reserved[3];
+};
+
+class Cartridge : public CartridgeState {
+  public:
+    Cartridge();
+    ~Cartridge();
+
+    uint8_t mapper;
+    uint8_t battery;
+
+    uint8_t* prgRom;
+    uint32_t prgRomSize;
+    uint8_t* chr;
+    uint32_t chrSize;
+    uint8_t chrIsRam;
+
+    // PRG-RAM at $6000-$7FFF. This is prgRamData unless a battery save has
+    // mapped its file in instead (see BatterySave.h).
+    uint8_t* prgRam;
+    uint8_t prgRamData[PRG_RAM_SIZE];
+
+    // The two extra nametables of a four-screen board, otherwise null
+    uint8_t* nametableRam;
+
+    // Parse an iNES image. Returns false for malformed images or mappers
+    // that aren't supported yet.
+    bool load(const uint8_t* data, uint32_t size);
+    void unload();
+
+    // Mappers switch mirroring through here, so the PPU's nametable table
+    // follows
+    void connectToPPU(PPU* p);
+    void setMirroring(Mirroring m);
+
+    // CPU side, $6000-$FFFF
+    uint8_t readPRG(uint16_t address);
+    void writePRG(uint16_t address, uint8_t value);
+
+    // PPU side, $0000-$1FFF
+    uint8_t readCHR(uint16_t address);
+    void writeCHR(uint16_t address, uint8_t value);
+
+  private:
+    PPU* ppu;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host time in microseconds, for measuring the emulator rather than driving
+// it. The Teensy's micros() is 32 bits and wraps every 71.6 minutes, so it
+// is extended to 64 bits here; that only works if something calls this at
+// least once per wrap, which FastForward and LatencyMeter do every frame.
+#ifdef ARDUINO
+#include <Arduino.h>
+
+inline uint64_t nowMicros() {
+  static uint32_t last = 0;
+  static uint64_t wraps = 0;
+  uint32_t now = micros();
+  if (now < last) wraps += 1ull << 32;
+  last = now;
+  return wraps | now;
+}
+#else
+#include <time.h>
+
+inline uint64_t nowMicros() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+#endif
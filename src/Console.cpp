@@ -0,0 +1,138 @@
+#include <string.h>
+#include "Console.h"
+#include "Footprint.h"
+
+Console::Console() {
+  cpu.connectToBus(&bus);
+  bus.connectToPPU(&ppu);
+  ppu.connectToCartridge(&cart);
+}
+
+Console::~Console() {}
+
+COLD_CODE bool Console::loadROM(const uint8_t* data, uint32_t size) {
+  if (!cart.load(data, size)) return false;
+  bus.insertCartridge(&cart);
+  powerOn();
+  return true;
+}
+
+COLD_CODE void Console::powerOn() {
+  bus.reset();
+  ppu.reset();
+  cpu.a = cpu.x = cpu.y = 0;
+  cpu.totalCycles = 0;
+  cpu.reset();
+}
+
+void Console::setButtons(uint8_t port, uint8_t buttons) {
+  bus.controllers[port & 0x01].buttons = buttons;
+}
+
+HOT_CODE void Console::step() {
+  cpu.step();
+
+  uint32_t cycles = cpu.cycles;
+  if (bus.stallCycles) {
+    cycles += bus.stallCycles;
+    cpu.totalCycles += bus.stallCycles;
+    bus.stallCycles = 0;
+  }
+  ppu.tick(cycles);
+
+  if (ppu.nmiPending) {
+    ppu.nmiPending = 0;
+    cpu.nmi();
+    ppu.tick(cpu.cycles);
+  }
+}
+
+HOT_CODE void Console::runFrame() {
+  ppu.frameComplete = 0;
+  while (!ppu.frameComplete) step();
+}
+
+// Savestates
+int Console::stateBlocks(StateBlock* blocks) {
+  int count = 0;
+  blocks[count++] = { SECTION_CPU, static_cast<CPURegisters*>(&cpu), sizeof(CPURegisters) };
+  blocks[count++] = { SECTION_BUS, static_cast<BusState*>(&bus), sizeof(BusState) };
+  blocks[count++] = { SECTION_PPU, static_cast<PPUState*>(&ppu), sizeof(PPUState) };
+  blocks[count++] = { SECTION_CART, static_cast<CartridgeState*>(&cart), sizeof(CartridgeState) };
+  blocks[count++] = { SECTION_PRG_RAM, cart.prgRam, PRG_RAM_SIZE };
+  if (cart.chrIsRam) blocks[count++] = { SECTION_CHR_RAM, cart.chr, cart.chrSize };
+  if (cart.nametableRam) blocks[count++] = { SECTION_NT_RAM, cart.nametableRam, NAMETABLE_SIZE * 2 };
+  return count;
+}
+
+COLD_CODE uint32_t Console::stateSize() {
+  StateBlock blocks[MAX_STATE_BLOCKS];
+  int count = stateBlocks(blocks);
+
+  uint32_t size = sizeof(SavestateHeader);
+  for (int i = 0; i < count; i++) {
+    size += sizeof(SavestateSection) + blocks[i].size;
+  }
+  return size;
+}
+
+COLD_CODE uint32_t Console::saveState(uint8_t* buffer, uint32_t capacity) {
+  StateBlock blocks[MAX_STATE_BLOCKS];
+  int count = stateBlocks(blocks);
+  if (capacity < stateSize()) return 0;
+
+  SavestateHeader header = { { 'T', 'N', 'S', 'S' }, SAVESTATE_VERSION, (uint16_t)count, cart.prgRomSize, cart.chrSize };
+  memcpy(buffer, &header, sizeof(header));
+  uint32_t offset = sizeof(header);
+
+  for (int i = 0; i < count; i++) {
+    SavestateSection section = { blocks[i].id, blocks[i].size };
+    memcpy(buffer + offset, &section, sizeof(section));
+    memcpy(buffer + offset + sizeof(section), blocks[i].data, blocks[i].size);
+    offset += sizeof(section) + blocks[i].size;
+  }
+  return offset;
+}
+
+COLD_CODE bool Console::loadState(const uint8_t* data, uint32_t size) {
+  StateBlock blocks[MAX_STATE_BLOCKS];
+  int count = stateBlocks(blocks);
+
+  SavestateHeader header;
+  if (size < sizeof(header)) return false;
+  memcpy(&header, data, sizeof(header));
+
+  if (memcmp(header.magic, "TNSS", 4) != 0 || header.version != SAVESTATE_VERSION) return false;
+  if (header.prgRomSize != cart.prgRomSize || header.chrSize != cart.chrSize) return false;
+
+  // Find every block before copying anything, so a bad state changes nothing
+  const uint8_t* sources[MAX_STATE_BLOCKS] = { 0 };
+  uint32_t offset = sizeof(header);
+
+  for (int s = 0; s < header.sectionCount; s++) {
+    SavestateSection section;
+    if (offset + sizeof(section) > size) return false;
+    memcpy(&section, data + offset, sizeof(section));
+    offset += sizeof(section);
+    if (offset + section.size > size) return false;
+
+    // Sections this build doesn't know about are skipped
+    for (int i = 0; i < count; i++) {
+      if (blocks[i].id != section.id) continue;
+      if (blocks[i].size != section.size) return false;
+      sources[i] = data + offset;
+    }
+    offset += section.size;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (!sources[i]) return false;
+  }
+  for (int i = 0; i < count; i++) {
+    memcpy(blocks[i].data, sources[i], blocks[i].size);
+  }
+
+  // The mirroring mode may have been switched since the state was saved
+  ppu.mapNametables();
+  return true;
+}
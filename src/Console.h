@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include "CPU.h"
+#include "Bus.h"
+#include "PPU.h"
+#include "Cartridge.h"
+#include "Savestate.h"
+
+// Owns every component of one emulated machine. The CPU comes first so its
+// registers, cycle counter and page table pointers share the first cache
+// line of the object; the bus, PPU and cartridge follow.
+class alignas(64) Console {
+  public:
+    Console();
+    ~Console();
+
+    CPU6502 cpu;
+    Bus bus;
+    PPU ppu;
+    Cartridge cart;
+
+    // Load an iNES image and power on. Returns false if it can't be loaded.
+    bool loadROM(const uint8_t* data, uint32_t size);
+    void powerOn();
+
+    void setButtons(uint8_t port, uint8_t buttons);
+
+    void step();
+    void runFrame();
+
+    // Savestates. saveState() returns the number of bytes written, or 0 if
+    // the buffer is too small; loadState() leaves the console untouched if
+    // the state doesn't match the loaded ROM or this version.
+    uint32_t stateSize();
+    uint32_t saveState(uint8_t* buffer, uint32_t capacity);
+    bool loadState(const uint8_t* data, uint32_t size);
+
+  private:
+    int stateBlocks(StateBlock* blocks);
+};
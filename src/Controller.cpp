@@ -0,0 +1,20 @@
+#include "Controller.h"
+
+void Controller::reset() {
+  buttons = 0;
+  shift = 0;
+  strobe = 0;
+}
+
+void Controller::write(uint8_t value) {
+  strobe = value & 0x01;
+  if (strobe) shift = buttons;
+}
+
+uint8_t Controller::read() {
+  if (strobe) return buttons & 0x01;
+
+  uint8_t bit = shift & 0x01;
+  shift = (shift >> 1) | 0x80;
+  return bit;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+#define BUTTON_A      (1 << 0)
+#define BUTTON_B      (1 << 1)
+#define BUTTON_SELECT (1 << 2)
+#define BUTTON_START  (1 << 3)
+#define BUTTON_UP     (1 << 4)
+#define BUTTON_DOWN   (1 << 5)
+#define BUTTON_LEFT   (1 << 6)
+#define BUTTON_RIGHT  (1 << 7)
+
+// Standard controller on $4016/$4017. The pad's 4021 shift register is
+// reloaded from the buttons while the strobe is high, so reads keep
+// returning A. Once the strobe goes low each read shifts out the next
+// button, and after all eight the register has filled with ones.
+//
+// Plain data, so it can live in BusState and be saved with it.
+struct Controller {
+  uint8_t buttons;
+  uint8_t shift;
+  uint8_t strobe;
+
+  void reset();
+  void write(uint8_t value);
+  uint8_t read();
+};
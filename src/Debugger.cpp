@@ -0,0 +1,168 @@
+#include <string.h>
+#include "Debugger.h"
+
+#ifdef CPU_DEBUG
+
+#define BITMAP_SIZE (DEBUG_ADDRESSES / 8)
+
+Debugger* Debugger::active = 0;
+
+static bool testBit(const uint8_t* bits, uint16_t address) {
+  return bits[address >> 3] & (1 << (address & 7));
+}
+
+static void setBit(uint8_t* bits, uint16_t address, bool value) {
+  if (value) {
+    bits[address >> 3] |= 1 << (address & 7);
+  } else {
+    bits[address >> 3] &= ~(1 << (address & 7));
+  }
+}
+
+// Mirrors share one address: internal RAM repeats every 2KB up to $2000 and
+// the PPU registers every 8 bytes up to $4000
+static uint16_t canonical(uint16_t address) {
+  if (address < 0x2000) return address & (RAM_SIZE - 1);
+  if (address < 0x4000) return 0x2000 | (address & 0x07);
+  return address;
+}
+
+Debugger::Debugger(Console* c) : console(c) {
+  breakpoints = new uint8_t[BITMAP_SIZE];
+  watchReads = new uint8_t[BITMAP_SIZE];
+  watchWrites = new uint8_t[BITMAP_SIZE];
+  active = this;
+  clear();
+}
+
+Debugger::~Debugger() {
+  if (active == this) {
+    active = 0;
+    (*console).bus.mapPages();
+  }
+  delete[] breakpoints;
+  delete[] watchReads;
+  delete[] watchWrites;
+}
+
+void Debugger::clear() {
+  memset(breakpoints, 0, BITMAP_SIZE);
+  memset(watchReads, 0, BITMAP_SIZE);
+  memset(watchWrites, 0, BITMAP_SIZE);
+  memset(pageWatches, 0, sizeof(pageWatches));
+  breakpointCount = 0;
+  stopReason = STOP_NONE;
+  stopAddress = stopPC = 0;
+  stopValue = 0;
+  skipBreakpoint = false;
+  midFrame = false;
+  remap();
+}
+
+void Debugger::setBreakpoint(uint16_t address, bool enabled) {
+  if (testBit(breakpoints, address) == enabled) return;
+  setBit(breakpoints, address, enabled);
+  breakpointCount += enabled ? 1 : -1;
+}
+
+void Debugger::setWatchpoint(uint16_t address, uint8_t kinds) {
+  address = canonical(address);
+  bool watched = testBit(watchReads, address) || testBit(watchWrites, address);
+  setBit(watchReads, address, kinds & WATCH_READ);
+  setBit(watchWrites, address, kinds & WATCH_WRITE);
+
+  // The page table only changes when a page gains its first watchpoint or
+  // loses its last
+  if (watched == (kinds != 0)) return;
+  pageWatches[address >> 8] += kinds ? 1 : -1;
+  remap();
+}
+
+void Debugger::remap() {
+  if (active == this) (*console).bus.mapPages();
+}
+
+// Called by the bus once it has built its page tables
+void Debugger::unmapWatched(Bus* bus) {
+  if (bus != &(*console).bus) return;
+
+  for (int page = 0; page < PAGE_COUNT; page++) {
+    if (!pageWatches[page]) continue;
+
+    // A RAM page goes in every one of its mirrors
+    bool ram = page < (RAM_SIZE >> 8);
+    int end = ram ? 0x20 : page + 1;
+    for (int mirror = page; mirror < end; mirror += RAM_SIZE >> 8) {
+      (*bus).readPages[mirror] = (*bus).writePages[mirror] = 0;
+    }
+  }
+}
+
+// Called by the bus for every access to a page that isn't mapped directly
+void Debugger::access(Bus* bus, uint16_t address, uint8_t kind, uint8_t value) {
+  if (stopReason != STOP_NONE || bus != &(*console).bus) return;
+
+  const uint8_t* watches = kind == WATCH_READ ? watchReads : watchWrites;
+  if (!testBit(watches, canonical(address))) return;
+
+  stopReason = kind == WATCH_READ ? STOP_WATCH_READ : STOP_WATCH_WRITE;
+  stopAddress = address;
+  stopValue = value;
+}
+
+bool Debugger::checkBreakpoint(uint16_t pc) {
+  if (skipBreakpoint) {
+    skipBreakpoint = false;
+    return false;
+  }
+  if (!testBit(breakpoints, pc)) return false;
+
+  stopReason = STOP_BREAKPOINT;
+  stopPC = pc;
+  return true;
+}
+
+// A breakpoint that just stopped execution must not stop it again straight
+// away
+void Debugger::resume() {
+  skipBreakpoint = stopReason == STOP_BREAKPOINT;
+  stopReason = STOP_NONE;
+  if (!midFrame) {
+    (*console).ppu.frameComplete = 0;
+    midFrame = true;
+  }
+}
+
+uint8_t Debugger::runFrame() {
+  resume();
+
+  while (!(*console).ppu.frameComplete) {
+    uint16_t pc = (*console).cpu.pc;
+    (*console).step();
+    skipBreakpoint = false;
+    if (stopReason == STOP_BREAKPOINT) return stopReason;
+    if (stopReason != STOP_NONE) {
+      stopPC = pc;
+      return stopReason;
+    }
+  }
+
+  midFrame = false;
+  stopReason = STOP_FRAME;
+  return stopReason;
+}
+
+uint8_t Debugger::step() {
+  resume();
+  skipBreakpoint = true;
+
+  uint16_t pc = (*console).cpu.pc;
+  (*console).step();
+  if (stopReason != STOP_NONE) stopPC = pc;
+  skipBreakpoint = false;
+
+  if ((*console).ppu.frameComplete) midFrame = false;
+  return stopReason;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+// Execution breakpoints and memory watchpoints. Only built with CPU_DEBUG
+// (make DEBUG=1); without it neither the CPU nor the bus has any hooks.
+//
+// Breakpoints are a bitmap over the address space, consulted before each
+// instruction only while at least one is set. Watchpoints take their page
+// out of the bus page tables, so accesses to it go through Bus::read/write,
+// which report them here; every other page keeps the direct pointer path.
+#ifdef CPU_DEBUG
+
+#define WATCH_READ 0x01
+#define WATCH_WRITE 0x02
+
+#define STOP_NONE 0
+#define STOP_FRAME 1       // The frame completed
+#define STOP_BREAKPOINT 2  // About to execute the instruction at stopPC
+#define STOP_WATCH_READ 3  // The instruction at stopPC read stopValue from stopAddress
+#define STOP_WATCH_WRITE 4 // The instruction at stopPC wrote stopValue to stopAddress
+
+#define DEBUG_ADDRESSES 0x10000
+
+// Attaches to one console for its lifetime. Only one debugger is active at a
+// time, and while it is, the console must be run through it rather than
+// through Console::runFrame, which doesn't stop at breakpoints.
+class Debugger {
+  public:
+    Debugger(Console* c);
+    ~Debugger();
+
+    static Debugger* active;
+
+    void setBreakpoint(uint16_t address, bool enabled);
+
+    // kinds is WATCH_READ and/or WATCH_WRITE; 0 removes the watchpoint.
+    // Internal RAM and PPU register mirrors are watched together.
+    void setWatchpoint(uint16_t address, uint8_t kinds);
+    void clear();
+
+    // Run to the end of the frame or the next stop, and return why it
+    // stopped. After a stop, calling again carries on from there.
+    uint8_t runFrame();
+
+    // Execute one instruction, ignoring a breakpoint on it. Returns
+    // STOP_NONE unless it hit a watchpoint.
+    uint8_t step();
+
+    uint8_t stopReason;
+    uint16_t stopAddress;
+    uint16_t stopPC;
+    uint8_t stopValue;
+
+    // Hooks for the CPU and bus
+    inline bool breakAt(CPU6502* cpu) {
+      if (breakpointCount == 0 || cpu != &(*console).cpu) return false;
+      return checkBreakpoint((*cpu).pc);
+    }
+    void access(Bus* bus, uint16_t address, uint8_t kind, uint8_t value);
+    void unmapWatched(Bus* bus);
+
+  private:
+    Console* console;
+
+    uint8_t* breakpoints;
+    uint8_t* watchReads;
+    uint8_t* watchWrites;
+    uint16_t pageWatches[PAGE_COUNT];
+    uint32_t breakpointCount;
+
+    bool skipBreakpoint;
+    bool midFrame;
+
+    bool checkBreakpoint(uint16_t pc);
+    void resume();
+    void remap();
+};
+
+#endif
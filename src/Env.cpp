@@ -0,0 +1,191 @@
+#include <string.h>
+#include "Env.h"
+#include "Console.h"
+
+static_assert(TNES_OBSERVATION_FRAMEBUFFER == FRAMEBUFFER_SIZE, "observations must match the framebuffer");
+static_assert(TNES_OBSERVATION_RAM == RAM_SIZE, "observations must match work RAM");
+
+#ifndef ARDUINO
+
+#include <pthread.h>
+#include <unistd.h>
+
+struct EnvWorker {
+  TnesEnv* env;
+  uint32_t index;
+  pthread_t thread;
+};
+
+// Thread 0 is whichever thread calls tnes_env_step; the others wait for each
+// step and run their own fixed slice of the consoles, so a console always
+// stays on the same thread
+struct TnesEnv {
+  Console* consoles;
+  uint32_t count;
+  uint8_t* observations;
+  const uint8_t* buttons;
+  bool loaded;
+
+  EnvWorker* workers;
+  uint32_t threadCount;
+  pthread_mutex_t lock;
+  pthread_cond_t started;
+  pthread_cond_t finished;
+  uint64_t generation;
+  uint32_t pending;
+  bool stopping;
+};
+
+static void runSlice(TnesEnv* env, uint32_t part) {
+  uint32_t begin = (uint64_t)(*env).count * part / (*env).threadCount;
+  uint32_t end = (uint64_t)(*env).count * (part + 1) / (*env).threadCount;
+
+  for (uint32_t i = begin; i < end; i++) {
+    Console& console = (*env).consoles[i];
+    if ((*env).buttons) {
+      console.setButtons(0, (*env).buttons[i * 2]);
+      console.setButtons(1, (*env).buttons[i * 2 + 1]);
+    }
+    console.runFrame();
+
+    // Work RAM is part of the savestate block, so it is copied out rather
+    // than mapped like the framebuffer
+    if ((*env).observations) {
+      memcpy((*env).observations + (uint64_t)i * TNES_OBSERVATION_SIZE + TNES_OBSERVATION_FRAMEBUFFER, console.bus.ram, RAM_SIZE);
+    }
+  }
+}
+
+static void* runWorker(void* self) {
+  EnvWorker& worker = *(EnvWorker*)self;
+  TnesEnv* env = worker.env;
+  uint64_t seen = 0;
+
+  pthread_mutex_lock(&(*env).lock);
+  while (true) {
+    while ((*env).generation == seen && !(*env).stopping) pthread_cond_wait(&(*env).started, &(*env).lock);
+    if ((*env).stopping) break;
+    seen = (*env).generation;
+    pthread_mutex_unlock(&(*env).lock);
+
+    runSlice(env, worker.index);
+
+    pthread_mutex_lock(&(*env).lock);
+    if (--(*env).pending == 0) pthread_cond_signal(&(*env).finished);
+  }
+  pthread_mutex_unlock(&(*env).lock);
+  return 0;
+}
+
+uint32_t tnes_env_version(void) {
+  return TNES_ENV_VERSION;
+}
+
+TnesEnv* tnes_env_create(uint32_t count, uint32_t threads) {
+  if (count == 0) return 0;
+  if (threads == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cores > 0 ? cores : 1;
+  }
+  if (threads > count) threads = count;
+
+  TnesEnv* env = new TnesEnv();
+  (*env).consoles = new Console[count];
+  (*env).count = count;
+  (*env).observations = 0;
+  (*env).buttons = 0;
+  (*env).loaded = false;
+
+  (*env).workers = new EnvWorker[threads];
+  (*env).threadCount = threads;
+  pthread_mutex_init(&(*env).lock, 0);
+  pthread_cond_init(&(*env).started, 0);
+  pthread_cond_init(&(*env).finished, 0);
+  (*env).generation = 0;
+  (*env).pending = 0;
+  (*env).stopping = false;
+
+  // Worker 0 is the caller; if a thread can't be started the ones that did
+  // take its share
+  uint32_t started = 1;
+  for (uint32_t i = 1; i < threads; i++) {
+    EnvWorker& worker = (*env).workers[started];
+    worker.env = env;
+    worker.index = started;
+    if (pthread_create(&worker.thread, 0, runWorker, &worker) == 0) started++;
+  }
+  pthread_mutex_lock(&(*env).lock);
+  (*env).threadCount = started;
+  pthread_mutex_unlock(&(*env).lock);
+  return env;
+}
+
+void tnes_env_destroy(TnesEnv* env) {
+  if (!env) return;
+
+  pthread_mutex_lock(&(*env).lock);
+  (*env).stopping = true;
+  pthread_cond_broadcast(&(*env).started);
+  pthread_mutex_unlock(&(*env).lock);
+  for (uint32_t i = 1; i < (*env).threadCount; i++) pthread_join((*env).workers[i].thread, 0);
+
+  pthread_cond_destroy(&(*env).started);
+  pthread_cond_destroy(&(*env).finished);
+  pthread_mutex_destroy(&(*env).lock);
+  delete[] (*env).workers;
+  delete[] (*env).consoles;
+  delete env;
+}
+
+uint32_t tnes_env_count(TnesEnv* env) {
+  return (*env).count;
+}
+
+int tnes_env_load_rom(TnesEnv* env, const uint8_t* data, uint32_t size) {
+  (*env).loaded = false;
+  for (uint32_t i = 0; i < (*env).count; i++) {
+    if (!(*env).consoles[i].loadROM(data, size)) return 0;
+  }
+  (*env).loaded = true;
+  return 1;
+}
+
+int tnes_env_set_observations(TnesEnv* env, uint8_t* buffer, uint64_t size) {
+  if (buffer && size < (uint64_t)(*env).count * TNES_OBSERVATION_SIZE) return 0;
+
+  (*env).observations = buffer;
+  for (uint32_t i = 0; i < (*env).count; i++) {
+    PPU& ppu = (*env).consoles[i].ppu;
+    uint8_t* framebuffer = buffer ? buffer + (uint64_t)i * TNES_OBSERVATION_SIZE : ppu.framebufferData;
+
+    // The new buffer starts out with the current picture
+    if (framebuffer != ppu.framebuffer) memcpy(framebuffer, ppu.framebuffer, FRAMEBUFFER_SIZE);
+    ppu.framebuffer = framebuffer;
+    if (buffer) memcpy(buffer + (uint64_t)i * TNES_OBSERVATION_SIZE + TNES_OBSERVATION_FRAMEBUFFER, (*env).consoles[i].bus.ram, RAM_SIZE);
+  }
+  return 1;
+}
+
+void tnes_env_reset(TnesEnv* env, uint32_t index) {
+  if (index < (*env).count && (*env).loaded) (*env).consoles[index].powerOn();
+}
+
+int tnes_env_step(TnesEnv* env, const uint8_t* buttons) {
+  if (!(*env).loaded) return 0;
+
+  pthread_mutex_lock(&(*env).lock);
+  (*env).buttons = buttons;
+  (*env).pending = (*env).threadCount - 1;
+  (*env).generation++;
+  pthread_cond_broadcast(&(*env).started);
+  pthread_mutex_unlock(&(*env).lock);
+
+  runSlice(env, 0);
+
+  pthread_mutex_lock(&(*env).lock);
+  while ((*env).pending) pthread_cond_wait(&(*env).finished, &(*env).lock);
+  pthread_mutex_unlock(&(*env).lock);
+  return 1;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+// C interface for driving many consoles from another language, one frame at
+// a time: a reinforcement learning harness, say. Everything crosses the
+// boundary as plain C types and stays ABI compatible within one
+// TNES_ENV_VERSION. make builds it into bin/libtnes.so, which exports these
+// functions and nothing else.
+//
+// A batch holds `count` consoles running the same ROM. tnes_env_step runs
+// one frame on all of them, split across the batch's threads. Observations
+// go into one buffer owned by the caller, TNES_OBSERVATION_SIZE bytes per
+// console, back to back: the framebuffer (6-bit colour indices, row by row),
+// which the PPU draws into directly, then the 2KB of work RAM as it was at
+// the end of the frame. Stepping allocates nothing.
+#define TNES_ENV_VERSION 1
+
+#define TNES_OBSERVATION_FRAMEBUFFER (256 * 240)
+#define TNES_OBSERVATION_RAM 2048
+#define TNES_OBSERVATION_SIZE (TNES_OBSERVATION_FRAMEBUFFER + TNES_OBSERVATION_RAM)
+
+#if defined(__GNUC__)
+#define TNES_API __attribute__((visibility("default")))
+#else
+#define TNES_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TnesEnv TnesEnv;
+
+TNES_API uint32_t tnes_env_version(void);
+
+// threads is the number of threads stepping the batch, the caller's
+// included; 0 uses one per core. Returns null if it can't be created.
+TNES_API TnesEnv* tnes_env_create(uint32_t count, uint32_t threads);
+TNES_API void tnes_env_destroy(TnesEnv* env);
+
+TNES_API uint32_t tnes_env_count(TnesEnv* env);
+
+// Load an iNES image into every console and power them on. The image is
+// copied. Returns 0 if it isn't a supported ROM.
+TNES_API int tnes_env_load_rom(TnesEnv* env, const uint8_t* data, uint32_t size);
+
+// Point the batch at count * TNES_OBSERVATION_SIZE bytes, which must stay
+// valid until it is replaced or the batch is destroyed. Null detaches it.
+// Returns 0 if the buffer is too small.
+TNES_API int tnes_env_set_observations(TnesEnv* env, uint8_t* buffer, uint64_t size);
+
+// Power one console back on, as at the start of an episode
+TNES_API void tnes_env_reset(TnesEnv* env, uint32_t index);
+
+// Run one frame on every console. buttons holds two controller bytes per
+// console, ports 1 and 2, or is null for no input. Returns 0 if no ROM is
+// loaded.
+TNES_API int tnes_env_step(TnesEnv* env, const uint8_t* buttons);
+
+#ifdef __cplusplus
+}
+#endif
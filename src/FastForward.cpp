@@ -0,0 +1,37 @@
+#include "FastForward.h"
+#include "Clock.h"
+
+FastForward::FastForward(Console* c, uint32_t n) : interval(n), console(c), phase(0) {
+  restart();
+}
+
+void FastForward::restart() {
+  frameCount = 0;
+  startMicros = nowMicros();
+}
+
+uint64_t FastForward::frames() {
+  return frameCount;
+}
+
+double FastForward::speed() {
+  uint64_t elapsed = nowMicros() - startMicros;
+  if (elapsed == 0) return 0.0;
+  return (double)frameCount * FRAME_RATE_DEN / FRAME_RATE_NUM * 1e6 / elapsed;
+}
+
+bool FastForward::runFrame() {
+  bool present = interval <= 1 || ++phase >= interval;
+  if (present) phase = 0;
+
+  (*console).ppu.skipRender = !present;
+  (*console).runFrame();
+  (*console).ppu.skipRender = 0;
+
+  frameCount++;
+#ifdef ARDUINO
+  // Keeps the clock's 32-bit wrap count current between speed() calls
+  nowMicros();
+#endif
+  return present;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+// Fast-forward presents one frame in every `interval` and runs the others
+// with rendering skipped. Skipped frames still evaluate sprites and fetch the
+// background under sprite 0, so sprite 0 hit, sprite overflow and vblank/NMI
+// timing are exactly those of a rendered frame and the game can't tell the
+// difference; only the framebuffer is left stale.
+class FastForward {
+  public:
+    FastForward(Console* c, uint32_t interval);
+
+    // Present one frame in this many. 1 renders every frame.
+    uint32_t interval;
+
+    // Set the input with Console::setButtons first. Returns true if the
+    // frame was rendered and should be shown.
+    bool runFrame();
+
+    // Frames run and speed as a multiple of real time (60.0988 Hz) since
+    // construction or the last restart()
+    void restart();
+    uint64_t frames();
+    double speed();
+
+  private:
+    Console* console;
+    uint32_t phase;
+    uint64_t frameCount;
+    uint64_t startMicros;
+};
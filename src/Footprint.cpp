@@ -0,0 +1,20 @@
+#include "Footprint.h"
+#include "Console.h"
+#include "Movie.h"
+#include "Rewind.h"
+#include "RunAhead.h"
+
+// Every build checks these, the Teensy's included, so a component that grows
+// past its budget fails to compile rather than to fit on the hardware.
+// Pointers are 8 bytes on hosts and 4 on the Teensy; the budgets fit both.
+static_assert(sizeof(CPU6502) <= FOOTPRINT_CPU, "CPU6502 is over its footprint budget");
+static_assert(sizeof(Bus) <= FOOTPRINT_BUS, "Bus is over its footprint budget");
+static_assert(sizeof(PPU) <= FOOTPRINT_PPU, "PPU is over its footprint budget");
+static_assert(sizeof(Cartridge) <= FOOTPRINT_CARTRIDGE, "Cartridge is over its footprint budget");
+static_assert(sizeof(Console) <= FOOTPRINT_CONSOLE, "Console is over its footprint budget");
+static_assert(sizeof(RunAhead) <= FOOTPRINT_RUNAHEAD, "RunAhead is over its footprint budget");
+static_assert(sizeof(Rewind) <= FOOTPRINT_REWIND, "Rewind is over its footprint budget");
+static_assert(sizeof(Movie) <= FOOTPRINT_MOVIE, "Movie is over its footprint budget");
+
+// The whole console has to leave room in RAM1 for the code that runs it
+static_assert(sizeof(Console) <= FOOTPRINT_RAM1 / 4, "Console takes too much of RAM1");
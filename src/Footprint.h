@@ -0,0 +1,58 @@
+#pragma once
+
+// Memory footprint budgets and placement annotations.
+//
+// The Teensy 4.1 has 512KB of tightly coupled RAM (RAM1), shared in 32KB
+// banks between code (ITCM) and data (DTCM), 512KB of slower RAM (RAM2,
+// where the heap lives) and 8MB of flash. Unannotated code and const data
+// both land in RAM1, so anything that isn't run per frame is kept out of it:
+//
+//   HOT_CODE    runs every cycle or scanline; ITCM on the Teensy
+//   COLD_CODE   loaders, savestates, serialisation; run from flash
+//   CONST_DATA  tables that aren't read per instruction; kept in flash
+//   COLD_DATA   large buffers that don't need single-cycle access; RAM2
+//
+// On hosts HOT_CODE and COLD_CODE become GCC's hot and cold attributes, and
+// the data annotations do nothing.
+//
+// Footprint.cpp checks every component's size against its budget below at
+// compile time, and nes-footprint reports bytes per component and section
+// from a linker map (make footprint for the host build).
+#ifdef ARDUINO
+#include <Arduino.h>
+#define HOT_CODE FASTRUN
+#define COLD_CODE FLASHMEM
+#define CONST_DATA PROGMEM
+#define COLD_DATA DMAMEM
+#else
+#define HOT_CODE __attribute__((hot))
+#define COLD_CODE __attribute__((cold))
+#define CONST_DATA
+#define COLD_DATA
+#endif
+
+// Kernels written to auto-vectorise (lockstep lanes, hashing, pixel format
+// conversion) are built as AVX-512 and AVX2 clones next to the baseline on
+// x86, and the best one is picked at load time. Other targets just get the
+// auto-vectorised baseline.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && !defined(ARDUINO)
+#define VECTOR_CLONES __attribute__((target_clones("arch=skylake-avx512", "avx2", "default")))
+#else
+#define VECTOR_CLONES
+#endif
+
+// Budgets in bytes, per object
+#define FOOTPRINT_CPU 64
+#define FOOTPRINT_BUS (7 * 1024)
+#define FOOTPRINT_PPU (64 * 1024)
+#define FOOTPRINT_CARTRIDGE (9 * 1024)
+#define FOOTPRINT_CONSOLE (80 * 1024)
+#define FOOTPRINT_RUNAHEAD 64
+#define FOOTPRINT_REWIND 128
+#define FOOTPRINT_MOVIE 64
+
+// Memory regions on the Teensy 4.1, for nes-footprint
+#define FOOTPRINT_RAM1 (512 * 1024)
+#define FOOTPRINT_RAM2 (512 * 1024)
+#define FOOTPRINT_FLASH (8 * 1024 * 1024)
+#define FOOTPRINT_ITCM_BANK (32 * 1024)
@@ -0,0 +1,241 @@
+#include <string.h>
+#include "FrameHash.h"
+#include "Footprint.h"
+
+#define HASH_LANES 8
+#define HASH_STRIPE (HASH_LANES * 8)
+#define HASH_BLOCK_STRIPES 16
+
+#define PRIME32_1 0x9e3779b1ull
+#define PRIME64_1 0x9e3779b185ebca87ull
+#define PRIME64_2 0xc2b2ae3d27d4eb4full
+#define PRIME64_3 0x165667b19e3779f9ull
+
+static const uint64_t HASH_KEY[HASH_LANES] = {
+  0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+  0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull
+};
+
+static inline uint64_t load64(const uint8_t* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint64_t rotl64(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// Each lane also takes its neighbour's raw word, so a multiply by zero
+// can't wipe out what the stripe contributed. Pairs are written out so the
+// whole stripe vectorises as one block.
+static inline void accumulate(uint64_t* acc, const uint8_t* stripe, uint64_t salt) {
+  uint64_t value[HASH_LANES], product[HASH_LANES];
+  for (int i = 0; i < HASH_LANES; i++) {
+    value[i] = load64(stripe + i * 8);
+    uint64_t keyed = value[i] ^ (HASH_KEY[i] + salt);
+    product[i] = (keyed & 0xffffffff) * (keyed >> 32);
+  }
+  for (int i = 0; i < HASH_LANES; i += 2) {
+    acc[i] += product[i] + value[i + 1];
+    acc[i + 1] += product[i + 1] + value[i];
+  }
+}
+
+static inline void scramble(uint64_t* acc) {
+  for (int i = 0; i < HASH_LANES; i++) {
+    uint64_t value = acc[i];
+    value ^= value >> 47;
+    value ^= HASH_KEY[i];
+    acc[i] = value * PRIME32_1;
+  }
+}
+
+static inline uint64_t avalanche(uint64_t hash) {
+  hash ^= hash >> 37;
+  hash *= PRIME64_3;
+  return hash ^ (hash >> 32);
+}
+
+VECTOR_CLONES
+uint64_t hash64(const uint8_t* data, uint32_t size, uint64_t seed) {
+  uint64_t acc[HASH_LANES];
+  for (int i = 0; i < HASH_LANES; i++) acc[i] = HASH_KEY[(i + 3) % HASH_LANES] + seed;
+
+  uint32_t stripes = size / HASH_STRIPE;
+  for (uint32_t s = 0; s < stripes; s++) {
+    accumulate(acc, data + s * HASH_STRIPE, (s % HASH_BLOCK_STRIPES) * PRIME64_2);
+    if (s % HASH_BLOCK_STRIPES == HASH_BLOCK_STRIPES - 1) scramble(acc);
+  }
+
+  // The tail goes in as a zero padded stripe; the size tells it apart from
+  // real zeros
+  uint32_t tail = size % HASH_STRIPE;
+  if (tail) {
+    uint8_t last[HASH_STRIPE] = {};
+    memcpy(last, data + stripes * HASH_STRIPE, tail);
+    accumulate(acc, last, (stripes % HASH_BLOCK_STRIPES) * PRIME64_2);
+  }
+
+  uint64_t hash = (uint64_t)size * PRIME64_1 ^ seed;
+  for (int i = 0; i < HASH_LANES; i++) {
+    hash ^= rotl64(acc[i] * PRIME64_2, 31) * PRIME64_1;
+    hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_3;
+  }
+  return avalanche(hash);
+}
+
+uint64_t frameHash(Console& console, bool ram) {
+  uint64_t hash = hash64(console.ppu.framebuffer, FRAMEBUFFER_SIZE, 0);
+  if (ram) hash = hash64(console.bus.ram, sizeof(console.bus.ram), hash);
+  return hash;
+}
+
+HashLog::HashLog() : flags(0), runs(0), runCount(0), runCapacity(0), frameCount(0) {}
+
+HashLog::~HashLog() {
+  delete[] runs;
+}
+
+void HashLog::clear() {
+  runCount = 0;
+  frameCount = 0;
+}
+
+uint32_t HashLog::frames() {
+  return frameCount;
+}
+
+void HashLog::append(uint32_t length, uint64_t hash) {
+  if (runCount == runCapacity) {
+    runCapacity = runCapacity ? runCapacity * 2 : 64;
+    Run* grown = new Run[runCapacity];
+    if (runCount) memcpy(grown, runs, runCount * sizeof(Run));
+    delete[] runs;
+    runs = grown;
+  }
+  runs[runCount++] = { length, hash };
+}
+
+void HashLog::record(uint64_t hash) {
+  if (runCount && runs[runCount - 1].hash == hash) {
+    runs[runCount - 1].length++;
+  } else {
+    append(1, hash);
+  }
+  frameCount++;
+}
+
+void HashLog::record(Console& console) {
+  record(frameHash(console, flags & HASHLOG_RAM));
+}
+
+uint32_t HashLog::compare(HashLog& golden) {
+  if (flags != golden.flags) return 0;
+
+  // Walk both run lists together, a run boundary at a time
+  uint32_t frame = 0;
+  uint32_t i = 0, j = 0;
+  uint32_t usedA = 0, usedB = 0;
+  while (i < runCount && j < golden.runCount) {
+    if (runs[i].hash != golden.runs[j].hash) return frame;
+
+    uint32_t leftA = runs[i].length - usedA;
+    uint32_t leftB = golden.runs[j].length - usedB;
+    uint32_t step = leftA < leftB ? leftA : leftB;
+    frame += step;
+    usedA += step;
+    usedB += step;
+    if (usedA == runs[i].length) {
+      i++;
+      usedA = 0;
+    }
+    if (usedB == golden.runs[j].length) {
+      j++;
+      usedB = 0;
+    }
+  }
+
+  return frameCount == golden.frameCount ? HASHLOG_MATCH : frame;
+}
+
+// Serialisation
+static uint32_t varintSize(uint32_t value) {
+  uint32_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+uint32_t HashLog::size() {
+  uint32_t total = sizeof(HashLogHeader);
+  for (uint32_t i = 0; i < runCount; i++) {
+    total += varintSize(runs[i].length) + sizeof(uint64_t);
+  }
+  return total;
+}
+
+COLD_CODE uint32_t HashLog::save(uint8_t* buffer, uint32_t capacity) {
+  uint32_t total = size();
+  if (capacity < total) return 0;
+
+  HashLogHeader header = { { 'T', 'N', 'F', 'H' }, HASHLOG_VERSION, flags, frameCount, runCount };
+  memcpy(buffer, &header, sizeof(header));
+  uint8_t* out = buffer + sizeof(header);
+
+  for (uint32_t i = 0; i < runCount; i++) {
+    uint32_t length = runs[i].length;
+    while (length >= 0x80) {
+      *out++ = 0x80 | (length & 0x7f);
+      length >>= 7;
+    }
+    *out++ = length;
+    memcpy(out, &runs[i].hash, sizeof(uint64_t));
+    out += sizeof(uint64_t);
+  }
+
+  return total;
+}
+
+COLD_CODE bool HashLog::load(const uint8_t* data, uint32_t size) {
+  HashLogHeader header;
+  if (size < sizeof(header)) return false;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, "TNFH", 4) != 0 || header.version != HASHLOG_VERSION) return false;
+
+  const uint8_t* in = data + sizeof(header);
+  const uint8_t* end = data + size;
+
+  clear();
+  for (uint32_t i = 0; i < header.runCount; i++) {
+    uint32_t length = 0;
+    int shift = 0;
+    do {
+      if (in == end || shift > 28) {
+        clear();
+        return false;
+      }
+      length |= (uint32_t)(*in & 0x7f) << shift;
+      shift += 7;
+    } while (*in++ & 0x80);
+
+    if (end - in < (long)sizeof(uint64_t) || length == 0) {
+      clear();
+      return false;
+    }
+    uint64_t hash;
+    memcpy(&hash, in, sizeof(hash));
+    append(length, hash);
+    in += sizeof(uint64_t);
+    frameCount += length;
+  }
+
+  if (frameCount != header.frames) {
+    clear();
+    return false;
+  }
+  flags = header.flags;
+  return true;
+}
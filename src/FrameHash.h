@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+// 64-bit hash in the style of XXH3: eight 64-bit accumulators take a 64-byte
+// stripe at a time with 32x32->64 multiplies, which map straight onto vector
+// multiplies, and are scrambled every block of stripes. It is not bit
+// compatible with XXH3.
+uint64_t hash64(const uint8_t* data, uint32_t size, uint64_t seed);
+
+// Hash of the framebuffer, and with ram set of the 2KB work RAM as well
+uint64_t frameHash(Console& console, bool ram);
+
+// Hash log file layout: a header followed by runCount runs, each a LEB128
+// frame count and the hash every frame of the run had. Static screens
+// collapse into a single run.
+#define HASHLOG_VERSION 1
+
+// Flags: the hashes cover work RAM as well as the framebuffer
+#define HASHLOG_RAM 0x0001
+
+#define HASHLOG_MATCH 0xffffffff
+
+struct HashLogHeader {
+  char magic[4]; // "TNFH"
+  uint16_t version;
+  uint16_t flags;
+  uint32_t frames;
+  uint32_t runCount;
+};
+
+// Per-frame hashes of a run, for regression checks without writing images.
+// Record a frame after it has been run.
+class HashLog {
+  public:
+    HashLog();
+    ~HashLog();
+
+    // Owns its runs, so it can't be copied
+    HashLog(const HashLog&) = delete;
+    HashLog& operator=(const HashLog&) = delete;
+
+    uint16_t flags;
+
+    void clear();
+    uint32_t frames();
+
+    void record(uint64_t hash);
+    void record(Console& console);
+
+    // First frame where the two logs differ, or HASHLOG_MATCH. A log that
+    // is shorter or hashes different things differs at its end or frame 0.
+    uint32_t compare(HashLog& golden);
+
+    // Serialised form, same conventions as movies
+    uint32_t size();
+    uint32_t save(uint8_t* buffer, uint32_t capacity);
+    bool load(const uint8_t* data, uint32_t size);
+
+  private:
+    struct Run {
+      uint32_t length;
+      uint64_t hash;
+    };
+
+    Run* runs;
+    uint32_t runCount;
+    uint32_t runCapacity;
+    uint32_t frameCount;
+
+    void append(uint32_t length, uint64_t hash);
+};
@@ -0,0 +1,155 @@
+#include <string.h>
+#include "Latency.h"
+#include "FrameHash.h"
+#include "Clock.h"
+
+LatencyMeter::LatencyMeter(Console* c) : console(c) {
+  buttons[0] = (*console).bus.controllers[0].buttons;
+  buttons[1] = (*console).bus.controllers[1].buttons;
+  reset();
+  (*console).bus.pollHook = poll;
+  (*console).bus.pollContext = this;
+}
+
+LatencyMeter::~LatencyMeter() {
+  (*console).bus.pollHook = 0;
+  (*console).bus.pollContext = 0;
+}
+
+void LatencyMeter::reset() {
+  memset(stages, 0, sizeof(stages));
+  memset(events, 0, sizeof(events));
+  dropped = 0;
+  frames = 0;
+  waitingForPoll = 0;
+}
+
+void LatencyMeter::input(uint8_t port, uint8_t value) {
+  port &= 0x01;
+  if (value != buttons[port]) {
+    buttons[port] = value;
+    start(nowMicros());
+  }
+  (*console).setButtons(port, value);
+}
+
+void LatencyMeter::beginFrame() {
+  bool changed = false;
+  for (int port = 0; port < 2; port++) {
+    uint8_t value = (*console).bus.controllers[port].buttons;
+    changed = changed || value != buttons[port];
+    buttons[port] = value;
+  }
+  if (changed) start(nowMicros());
+}
+
+void LatencyMeter::endFrame() {
+  frames++;
+  uint64_t now = nowMicros();
+  bool hashed = false;
+  uint64_t hash = 0;
+
+  for (Event& event : events) {
+    if (!event.active) continue;
+
+    if (frames - event.startFrame > LATENCY_TIMEOUT) {
+      if (event.stage == LATENCY_POLL) waitingForPoll--;
+      event.active = 0;
+      dropped++;
+      continue;
+    }
+    if (event.stage != LATENCY_FRAME) continue;
+
+    if (!hashed) {
+      hash = hash64((*console).ppu.framebuffer, FRAMEBUFFER_SIZE, 0);
+      hashed = true;
+    }
+    if (hash != event.baseline) record(event, LATENCY_FRAME, now, frames);
+  }
+}
+
+void LatencyMeter::presented() {
+  uint64_t now = nowMicros();
+  for (Event& event : events) {
+    if (event.active && event.stage == LATENCY_PRESENT) record(event, LATENCY_PRESENT, now, frames);
+  }
+}
+
+void LatencyMeter::start(uint64_t now) {
+  for (Event& event : events) {
+    if (event.active) continue;
+
+    event.startMicros = now;
+    event.startFrame = frames;
+    event.baseline = hash64((*console).ppu.framebuffer, FRAMEBUFFER_SIZE, 0);
+    event.stage = LATENCY_POLL;
+    event.active = 1;
+    waitingForPoll++;
+    return;
+  }
+  dropped++;
+}
+
+// Frame latencies count the frames since the change, including the one the
+// stage was reached in
+void LatencyMeter::record(Event& event, uint8_t stage, uint64_t now, uint64_t frame) {
+  LatencyHistogram& histogram = stages[stage];
+  uint64_t elapsed = now - event.startMicros;
+  uint64_t elapsedFrames = frame - event.startFrame;
+
+  int bucket = 0;
+  while ((elapsed >> (bucket + 1)) && bucket < LATENCY_BUCKETS - 1) bucket++;
+  histogram.micros[bucket]++;
+  histogram.frames[elapsedFrames < LATENCY_FRAME_BUCKETS ? elapsedFrames : LATENCY_FRAME_BUCKETS - 1]++;
+  histogram.count++;
+  histogram.totalMicros += elapsed;
+
+  if (stage == LATENCY_POLL) waitingForPoll--;
+  event.stage = stage + 1;
+  if (event.stage == LATENCY_STAGES) event.active = 0;
+}
+
+// Called by the bus on every controller read
+void LatencyMeter::poll(void* self, uint8_t port) {
+  LatencyMeter& meter = *(LatencyMeter*)self;
+  if (!meter.waitingForPoll) return;
+
+  uint64_t now = nowMicros();
+  for (Event& event : meter.events) {
+    if (event.active && event.stage == LATENCY_POLL) meter.record(event, LATENCY_POLL, now, meter.frames + 1);
+  }
+}
+
+#ifndef ARDUINO
+
+// Upper bound of the bucket holding the given fraction of the samples
+static uint64_t percentile(const LatencyHistogram& histogram, double fraction) {
+  uint64_t target = (uint64_t)(histogram.count * fraction + 0.5);
+  uint64_t seen = 0;
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    seen += histogram.micros[b];
+    if (seen >= target && seen) return 2ull << b;
+  }
+  return 2ull << (LATENCY_BUCKETS - 1);
+}
+
+void LatencyMeter::report(FILE* out) {
+  const char* names[LATENCY_STAGES] = { "poll", "frame", "present" };
+
+  for (int s = 0; s < LATENCY_STAGES; s++) {
+    const LatencyHistogram& histogram = stages[s];
+    fprintf(out, "%-8s %6u events", names[s], histogram.count);
+    if (histogram.count) {
+      fprintf(out, "  mean %8.0fus  p50 <%lluus  p90 <%lluus  p99 <%lluus  frames",
+        (double)histogram.totalMicros / histogram.count, (unsigned long long)percentile(histogram, 0.5),
+        (unsigned long long)percentile(histogram, 0.9), (unsigned long long)percentile(histogram, 0.99));
+      for (int f = 0; f < LATENCY_FRAME_BUCKETS; f++) {
+        if (histogram.frames[f]) fprintf(out, " %d%s:%u", f, f == LATENCY_FRAME_BUCKETS - 1 ? "+" : "", histogram.frames[f]);
+      }
+    }
+    fprintf(out, "\n");
+  }
+  if (dropped) fprintf(out, "%u events dropped\n", dropped);
+}
+
+#endif
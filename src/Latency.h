@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+#ifndef ARDUINO
+#include <stdio.h>
+#endif
+
+// Input-to-photon latency. Every change of a controller's buttons starts an
+// event, which is timestamped as it reaches each stage of the pipeline:
+//
+//   LATENCY_POLL     the game's first read of $4016/$4017 after the change
+//   LATENCY_FRAME    the end of the first frame whose framebuffer differs
+//                    from the one on screen at the change
+//   LATENCY_PRESENT  that frame (or a later one) being presented
+//
+// Each stage has a histogram of the time since the change, in host
+// microseconds and in emulated frames. A frame that changes for its own
+// reasons (animation) ends the event early, so the frame stage waits until
+// the game has polled the input. Nothing runs per instruction: the bus calls
+// in on controller reads, and the framebuffer is only hashed while an event
+// waits for it, so the meter can stay on in release builds.
+#define LATENCY_POLL 0
+#define LATENCY_FRAME 1
+#define LATENCY_PRESENT 2
+#define LATENCY_STAGES 3
+
+// Microsecond bucket b counts latencies below 2^(b+1), down to 2^b
+#define LATENCY_BUCKETS 24
+// Frame bucket f counts latencies of f frames; the last one everything above
+#define LATENCY_FRAME_BUCKETS 16
+
+// Changes followed at once; one more is dropped
+#define LATENCY_EVENTS 8
+// Events whose frame never changes are dropped after this many frames
+#define LATENCY_TIMEOUT 120
+
+struct LatencyHistogram {
+  uint32_t micros[LATENCY_BUCKETS];
+  uint32_t frames[LATENCY_FRAME_BUCKETS];
+  uint32_t count;
+  uint64_t totalMicros;
+};
+
+class LatencyMeter {
+  public:
+    LatencyMeter(Console* c);
+    ~LatencyMeter();
+
+    // Pass buttons through here as soon as the host has them, so the event
+    // starts then. Changes made straight on the console (a movie, say) are
+    // still caught by beginFrame, from the start of the frame.
+    void input(uint8_t port, uint8_t buttons);
+
+    // Bracket each emulated frame, and call presented() once the frame has
+    // actually been shown
+    void beginFrame();
+    void endFrame();
+    void presented();
+
+    LatencyHistogram stages[LATENCY_STAGES];
+    uint32_t dropped;
+
+    void reset();
+
+#ifndef ARDUINO
+    // A line per stage with the count, mean and percentiles, then the frame
+    // histogram
+    void report(FILE* out);
+#endif
+
+  private:
+    struct Event {
+      uint64_t startMicros;
+      uint64_t startFrame;
+      uint64_t baseline; // Framebuffer hash at the change
+      uint8_t stage;     // Next stage to reach
+      uint8_t active;
+    };
+
+    Console* console;
+    Event events[LATENCY_EVENTS];
+    uint8_t buttons[2];
+    uint64_t frames;
+    uint8_t waitingForPoll;
+
+    void start(uint64_t now);
+    void record(Event& event, uint8_t stage, uint64_t now, uint64_t frame);
+    static void poll(void* self, uint8_t port);
+};
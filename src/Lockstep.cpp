@@ -0,0 +1,329 @@
+#include <string.h>
+#include "Lockstep.h"
+#include "Footprint.h"
+
+#define LANES LOCKSTEP_LANES
+
+// Lane kernels. Masks are 0x00 or 0xff per lane so that every update is a
+// branch-free blend, which the compiler turns into a handful of vector ops.
+static inline void blend(uint8_t* dst, const uint8_t* value, const uint8_t* mask) {
+  for (int i = 0; i < LANES; i++) {
+    dst[i] = (value[i] & mask[i]) | (dst[i] & ~mask[i]);
+  }
+}
+
+static inline void blendConstant(uint8_t* dst, uint8_t value, const uint8_t* mask) {
+  for (int i = 0; i < LANES; i++) {
+    dst[i] = (value & mask[i]) | (dst[i] & ~mask[i]);
+  }
+}
+
+static inline void assignNZ(uint8_t* p, const uint8_t* value, const uint8_t* mask) {
+  for (int i = 0; i < LANES; i++) {
+    uint8_t nz = (value[i] & STATUS_NEGATIVE) | (value[i] == 0 ? STATUS_ZERO : 0);
+    p[i] = (p[i] & ~(mask[i] & (STATUS_NEGATIVE | STATUS_ZERO))) | (nz & mask[i]);
+  }
+}
+
+static inline void assignFlag(uint8_t* p, uint8_t flag, bool set, const uint8_t* mask) {
+  for (int i = 0; i < LANES; i++) {
+    p[i] = (p[i] & ~(mask[i] & flag)) | (set ? (mask[i] & flag) : 0);
+  }
+}
+
+static inline void addConstant(uint8_t* dst, uint8_t value, const uint8_t* mask) {
+  for (int i = 0; i < LANES; i++) {
+    dst[i] += value & mask[i];
+  }
+}
+
+LockstepBatch::LockstepBatch() : laneCount(0), vectorSteps(0), vectorLanes(0), scalarSteps(0) {
+  for (int i = 0; i < LANES; i++) {
+    lanes[i] = new Console();
+  }
+  memset(done, 0xff, sizeof(done));
+  memset(active, 0, sizeof(active));
+  memset(laneCycles, 0, sizeof(laneCycles));
+}
+
+LockstepBatch::~LockstepBatch() {
+  for (int i = 0; i < LANES; i++) {
+    delete lanes[i];
+  }
+}
+
+bool LockstepBatch::loadROM(const uint8_t* data, uint32_t size, int count) {
+  if (count < 1 || count > LANES) return false;
+
+  for (int i = 0; i < count; i++) {
+    if (!(*lanes[i]).loadROM(data, size)) return false;
+    storeLane(i);
+  }
+  laneCount = count;
+  return true;
+}
+
+void LockstepBatch::setButtons(int lane, uint8_t port, uint8_t buttons) {
+  (*lanes[lane]).setButtons(port, buttons);
+}
+
+void LockstepBatch::runFrame() {
+  // Pick up anything done to the lanes' CPUs between frames (a loadState)
+  for (int i = 0; i < LANES; i++) {
+    done[i] = i < laneCount ? 0 : 0xff;
+    if (i < laneCount) {
+      (*lanes[i]).ppu.frameComplete = 0;
+      storeLane(i);
+    }
+  }
+
+  while (true) {
+    int leader = selectGroup();
+    if (leader < 0) break;
+
+    uint8_t bytes[3] = { 0, 0, 0 };
+    uint8_t** pages = (*lanes[leader]).bus.readPages;
+    for (int offset = 0; offset < 3; offset++) {
+      uint16_t address = pc[leader] + offset;
+      if (pages[address >> 8]) bytes[offset] = pages[address >> 8][address & 0xff];
+    }
+
+    if (pages[pc[leader] >> 8] && executeVector(bytes[0], bytes[1], bytes[1] | (bytes[2] << 8))) {
+      vectorSteps++;
+      finishVector();
+    } else {
+      for (int i = 0; i < LANES; i++) {
+        if (active[i]) executeScalar(i);
+      }
+    }
+
+    for (int i = 0; i < LANES; i++) {
+      if (active[i] && (*lanes[i]).ppu.frameComplete) done[i] = 0xff;
+    }
+  }
+
+  // Vector steps only update the arrays, so bring every lane's own CPU up to
+  // date for savestates and traces
+  for (int i = 0; i < laneCount; i++) loadLane(i);
+}
+
+// Pick the unfinished lane that is furthest behind and mark every lane that
+// is about to execute exactly the same instruction bytes as it. Returns the
+// leader, or -1 once every lane has finished its frame.
+int LockstepBatch::selectGroup() {
+  int leader = -1;
+  for (int i = 0; i < LANES; i++) {
+    if (done[i]) continue;
+    if (leader < 0 || totalCycles[i] < totalCycles[leader]) leader = i;
+  }
+
+  memset(active, 0, sizeof(active));
+  if (leader < 0) return -1;
+  active[leader] = 0xff;
+
+  // Code outside plain memory (I/O space) always runs on its own
+  uint16_t address = pc[leader];
+  uint8_t** pages = (*lanes[leader]).bus.readPages;
+  if (!pages[address >> 8]) return leader;
+
+  for (int i = 0; i < LANES; i++) {
+    if (done[i] || i == leader || pc[i] != address) continue;
+
+    uint8_t** lanePages = (*lanes[i]).bus.readPages;
+    bool same = true;
+    for (int offset = 0; offset < 3 && same; offset++) {
+      uint16_t byteAddress = address + offset;
+      uint8_t* a = pages[byteAddress >> 8];
+      uint8_t* b = lanePages[byteAddress >> 8];
+      if (!a || !b) break;
+      same = a[byteAddress & 0xff] == b[byteAddress & 0xff];
+    }
+    if (same) active[i] = 0xff;
+  }
+
+  return leader;
+}
+
+// Execute one instruction on every active lane at once. Returns false if the
+// opcode has no vector implementation, in which case nothing was changed.
+VECTOR_CLONES
+bool LockstepBatch::executeVector(uint8_t opcode, uint8_t operand, uint16_t address) {
+  alignas(64) uint8_t value[LANES];
+  uint8_t length = 1;
+  uint8_t cycles = 2;
+
+  switch (opcode) {
+    // Flags
+    case 0x18: assignFlag(p, 1 << CARRY_BIT, false, active); break;
+    case 0x38: assignFlag(p, 1 << CARRY_BIT, true, active); break;
+    case 0x58: assignFlag(p, STATUS_INTERRUPT, false, active); break;
+    case 0x78: assignFlag(p, STATUS_INTERRUPT, true, active); break;
+    case 0xB8: assignFlag(p, STATUS_OVERFLOW, false, active); break;
+    case 0xD8: assignFlag(p, STATUS_DECIMAL, false, active); break;
+    case 0xF8: assignFlag(p, STATUS_DECIMAL, true, active); break;
+
+    // Transfers
+    case 0xAA: blend(x, a, active); assignNZ(p, x, active); break;
+    case 0xA8: blend(y, a, active); assignNZ(p, y, active); break;
+    case 0x8A: blend(a, x, active); assignNZ(p, a, active); break;
+    case 0x98: blend(a, y, active); assignNZ(p, a, active); break;
+    case 0xBA: blend(x, sp, active); assignNZ(p, x, active); break;
+    case 0x9A: blend(sp, x, active); break;
+
+    // Increments and decrements
+    case 0xE8: addConstant(x, 1, active); assignNZ(p, x, active); break;
+    case 0xC8: addConstant(y, 1, active); assignNZ(p, y, active); break;
+    case 0xCA: addConstant(x, 0xff, active); assignNZ(p, x, active); break;
+    case 0x88: addConstant(y, 0xff, active); assignNZ(p, y, active); break;
+
+    // NOP
+    case 0xEA: case 0x1A: case 0x3A: case 0x5A: case 0x7A: case 0xDA: case 0xFA: break;
+
+    // Immediate
+    case 0xA9: blendConstant(a, operand, active); assignNZ(p, a, active); length = 2; break;
+    case 0xA2: blendConstant(x, operand, active); assignNZ(p, x, active); length = 2; break;
+    case 0xA0: blendConstant(y, operand, active); assignNZ(p, y, active); length = 2; break;
+    case 0x29: {
+      for (int i = 0; i < LANES; i++) value[i] = a[i] & operand;
+      blend(a, value, active);
+      assignNZ(p, a, active);
+      length = 2;
+      break;
+    }
+    case 0x09: {
+      for (int i = 0; i < LANES; i++) value[i] = a[i] | operand;
+      blend(a, value, active);
+      assignNZ(p, a, active);
+      length = 2;
+      break;
+    }
+    case 0x49: {
+      for (int i = 0; i < LANES; i++) value[i] = a[i] ^ operand;
+      blend(a, value, active);
+      assignNZ(p, a, active);
+      length = 2;
+      break;
+    }
+
+    // Zero page. Every lane has its own RAM, so these gather and scatter.
+    case 0xA5: case 0xA6: case 0xA4: case 0x25: case 0x05: case 0x45: case 0xE6: case 0xC6: {
+      for (int i = 0; i < LANES; i++) {
+        value[i] = active[i] ? (*lanes[i]).bus.ram[operand] : 0;
+      }
+      length = 2;
+      cycles = 3;
+
+      switch (opcode) {
+        case 0xA5: blend(a, value, active); assignNZ(p, a, active); break;
+        case 0xA6: blend(x, value, active); assignNZ(p, x, active); break;
+        case 0xA4: blend(y, value, active); assignNZ(p, y, active); break;
+        case 0x25: for (int i = 0; i < LANES; i++) value[i] &= a[i]; blend(a, value, active); assignNZ(p, a, active); break;
+        case 0x05: for (int i = 0; i < LANES; i++) value[i] |= a[i]; blend(a, value, active); assignNZ(p, a, active); break;
+        case 0x45: for (int i = 0; i < LANES; i++) value[i] ^= a[i]; blend(a, value, active); assignNZ(p, a, active); break;
+        default: {
+          addConstant(value, opcode == 0xE6 ? 1 : 0xff, active);
+          assignNZ(p, value, active);
+          for (int i = 0; i < LANES; i++) {
+            if (active[i]) (*lanes[i]).bus.ram[operand] = value[i];
+          }
+          cycles = 5;
+          break;
+        }
+      }
+      break;
+    }
+    case 0x85: case 0x86: {
+      const uint8_t* source = opcode == 0x85 ? a : x;
+      for (int i = 0; i < LANES; i++) {
+        if (active[i]) (*lanes[i]).bus.ram[operand] = source[i];
+      }
+      length = 2;
+      cycles = 3;
+      break;
+    }
+
+    // Branches are encoded as xxy10000: xx selects N/V/C/Z, y is the value tested
+    case 0x10: case 0x30: case 0x50: case 0x70: case 0x90: case 0xB0: case 0xD0: case 0xF0: {
+      const uint8_t flags[] = { NEGATIVE_BIT, OVERFLOW_BIT, CARRY_BIT, ZERO_BIT };
+      uint8_t flag = flags[opcode >> 6];
+      uint8_t expected = BIT_VALUE(opcode, 5);
+
+      for (int i = 0; i < LANES; i++) {
+        uint16_t next = pc[i] + 2;
+        uint16_t target = next + (int8_t)operand;
+        bool taken = ((p[i] >> flag) & 0x01) == expected;
+
+        laneCycles[i] = 2 + taken + (taken && (next & 0xff00) != (target & 0xff00));
+        if (active[i]) pc[i] = taken ? target : next;
+      }
+      return true;
+    }
+
+    // JMP absolute
+    case 0x4C: {
+      for (int i = 0; i < LANES; i++) {
+        if (active[i]) pc[i] = address;
+        laneCycles[i] = 3;
+      }
+      return true;
+    }
+
+    default: return false;
+  }
+
+  for (int i = 0; i < LANES; i++) {
+    if (active[i]) pc[i] += length;
+    laneCycles[i] = cycles;
+  }
+  return true;
+}
+
+// Advance the PPU of every lane that took part in a vector step, and deliver
+// any NMI it raised through that lane's scalar CPU
+void LockstepBatch::finishVector() {
+  for (int i = 0; i < LANES; i++) {
+    if (!active[i]) continue;
+    vectorLanes++;
+
+    Console& console = *lanes[i];
+    totalCycles[i] += laneCycles[i];
+    console.ppu.tick(laneCycles[i]);
+
+    if (console.ppu.nmiPending) {
+      loadLane(i);
+      console.ppu.nmiPending = 0;
+      console.cpu.nmi();
+      console.ppu.tick(console.cpu.cycles);
+      storeLane(i);
+    }
+  }
+}
+
+void LockstepBatch::executeScalar(int lane) {
+  scalarSteps++;
+  loadLane(lane);
+  (*lanes[lane]).step();
+  storeLane(lane);
+}
+
+void LockstepBatch::loadLane(int lane) {
+  CPU6502& cpu = (*lanes[lane]).cpu;
+  cpu.a = a[lane];
+  cpu.x = x[lane];
+  cpu.y = y[lane];
+  cpu.sp = sp[lane];
+  cpu.p = p[lane];
+  cpu.pc = pc[lane];
+  cpu.totalCycles = totalCycles[lane];
+}
+
+void LockstepBatch::storeLane(int lane) {
+  CPU6502& cpu = (*lanes[lane]).cpu;
+  a[lane] = cpu.a;
+  x[lane] = cpu.x;
+  y[lane] = cpu.y;
+  sp[lane] = cpu.sp;
+  p[lane] = cpu.p;
+  pc[lane] = cpu.pc;
+  totalCycles[lane] = cpu.totalCycles;
+}
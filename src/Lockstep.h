@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+// One AVX2 register holds 32 8-bit lanes
+#define LOCKSTEP_LANES 32
+
+// Runs up to LOCKSTEP_LANES instances of the same ROM side by side. The CPU
+// registers of every lane are kept in structure-of-arrays form, and lanes
+// sitting on the same instruction execute it together, one vector operation
+// per register. Lanes that have diverged are masked out and picked up again
+// when their group is scheduled; the group whose lane is furthest behind in
+// cycles always goes next, so lanes that reconverge fall back into step.
+//
+// Register, flag, branch and zero page instructions run on the vector path.
+// Everything else (I/O, absolute addressing, the stack) runs per lane on that
+// lane's own Console.
+class LockstepBatch {
+  public:
+    LockstepBatch();
+    ~LockstepBatch();
+
+    alignas(64) uint8_t a[LOCKSTEP_LANES];
+    alignas(64) uint8_t x[LOCKSTEP_LANES];
+    alignas(64) uint8_t y[LOCKSTEP_LANES];
+    alignas(64) uint8_t sp[LOCKSTEP_LANES];
+    alignas(64) uint8_t p[LOCKSTEP_LANES];
+    alignas(64) uint16_t pc[LOCKSTEP_LANES];
+    alignas(64) uint64_t totalCycles[LOCKSTEP_LANES];
+
+    // Memory, PPU and cartridge of each lane. Between frames each lane's
+    // Console is complete, CPU included, and can be saved or changed.
+    Console* lanes[LOCKSTEP_LANES];
+    int laneCount;
+
+    // Instructions executed on the vector path (counted once per group) and
+    // per lane on the scalar path
+    uint64_t vectorSteps;
+    uint64_t vectorLanes;
+    uint64_t scalarSteps;
+
+    // Load the same ROM into the first `count` lanes and power them on
+    bool loadROM(const uint8_t* data, uint32_t size, int count);
+    void setButtons(int lane, uint8_t port, uint8_t buttons);
+
+    // Run every lane until it has completed a frame
+    void runFrame();
+
+  private:
+    alignas(64) uint8_t active[LOCKSTEP_LANES];
+    alignas(64) uint8_t done[LOCKSTEP_LANES];
+    alignas(64) uint8_t laneCycles[LOCKSTEP_LANES];
+
+    int selectGroup();
+    bool executeVector(uint8_t opcode, uint8_t operand, uint16_t address);
+    void executeScalar(int lane);
+    void finishVector();
+
+    void loadLane(int lane);
+    void storeLane(int lane);
+};
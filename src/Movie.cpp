@@ -0,0 +1,147 @@
+#include <string.h>
+#include "Movie.h"
+#include "Footprint.h"
+
+#define MOVIE_PORTS 2
+
+Movie::Movie() : runs(0), runCount(0), runCapacity(0), frameCount(0), playRun(0), playFrame(0) {}
+
+Movie::~Movie() {
+  delete[] runs;
+}
+
+void Movie::clear() {
+  runCount = 0;
+  frameCount = 0;
+  restart();
+}
+
+uint32_t Movie::frames() {
+  return frameCount;
+}
+
+void Movie::append(uint32_t length, uint8_t port1, uint8_t port2) {
+  if (runCount == runCapacity) {
+    runCapacity = runCapacity ? runCapacity * 2 : 64;
+    Run* grown = new Run[runCapacity];
+    if (runCount) memcpy(grown, runs, runCount * sizeof(Run));
+    delete[] runs;
+    runs = grown;
+  }
+  runs[runCount++] = { length, { port1, port2 } };
+}
+
+void Movie::record(uint8_t port1, uint8_t port2) {
+  Run* last = runCount ? &runs[runCount - 1] : 0;
+  if (last && (*last).buttons[0] == port1 && (*last).buttons[1] == port2) {
+    (*last).length++;
+  } else {
+    append(1, port1, port2);
+  }
+  frameCount++;
+}
+
+void Movie::record(Console& console) {
+  record(console.bus.controllers[0].buttons, console.bus.controllers[1].buttons);
+}
+
+void Movie::restart() {
+  playRun = 0;
+  playFrame = 0;
+}
+
+bool Movie::play(Console& console) {
+  while (playRun < runCount && playFrame == runs[playRun].length) {
+    playRun++;
+    playFrame = 0;
+  }
+
+  if (playRun == runCount) {
+    console.setButtons(0, 0);
+    console.setButtons(1, 0);
+    return false;
+  }
+
+  console.setButtons(0, runs[playRun].buttons[0]);
+  console.setButtons(1, runs[playRun].buttons[1]);
+  playFrame++;
+  return true;
+}
+
+// Serialisation
+static uint32_t varintSize(uint32_t value) {
+  uint32_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+uint32_t Movie::size() {
+  uint32_t total = sizeof(MovieHeader);
+  for (uint32_t i = 0; i < runCount; i++) {
+    total += varintSize(runs[i].length) + MOVIE_PORTS;
+  }
+  return total;
+}
+
+COLD_CODE uint32_t Movie::save(uint8_t* buffer, uint32_t capacity) {
+  uint32_t total = size();
+  if (capacity < total) return 0;
+
+  MovieHeader header = { { 'T', 'N', 'M', 'V' }, MOVIE_VERSION, MOVIE_PORTS, frameCount, runCount };
+  memcpy(buffer, &header, sizeof(header));
+  uint8_t* out = buffer + sizeof(header);
+
+  for (uint32_t i = 0; i < runCount; i++) {
+    uint32_t length = runs[i].length;
+    while (length >= 0x80) {
+      *out++ = 0x80 | (length & 0x7f);
+      length >>= 7;
+    }
+    *out++ = length;
+    *out++ = runs[i].buttons[0];
+    *out++ = runs[i].buttons[1];
+  }
+
+  return total;
+}
+
+COLD_CODE bool Movie::load(const uint8_t* data, uint32_t size) {
+  MovieHeader header;
+  if (size < sizeof(header)) return false;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, "TNMV", 4) != 0 || header.version != MOVIE_VERSION || header.ports != MOVIE_PORTS) return false;
+
+  const uint8_t* in = data + sizeof(header);
+  const uint8_t* end = data + size;
+
+  clear();
+  for (uint32_t i = 0; i < header.runCount; i++) {
+    uint32_t length = 0;
+    int shift = 0;
+    do {
+      if (in == end || shift > 28) {
+        clear();
+        return false;
+      }
+      length |= (uint32_t)(*in & 0x7f) << shift;
+      shift += 7;
+    } while (*in++ & 0x80);
+
+    if (end - in < MOVIE_PORTS || length == 0) {
+      clear();
+      return false;
+    }
+    append(length, in[0], in[1]);
+    in += MOVIE_PORTS;
+    frameCount += length;
+  }
+
+  if (frameCount != header.frames) {
+    clear();
+    return false;
+  }
+  return true;
+}
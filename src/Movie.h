@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+// Movie file layout: a header followed by runCount runs, each a LEB128 frame
+// count and the buttons held on both ports for those frames. Input rarely
+// changes from one frame to the next, so a movie is usually a few bytes per
+// second of play.
+#define MOVIE_VERSION 1
+
+struct MovieHeader {
+  char magic[4]; // "TNMV"
+  uint16_t version;
+  uint16_t ports;
+  uint32_t frames;
+  uint32_t runCount;
+};
+
+// Per-frame input log for both controller ports. Record a frame after the
+// input is set and before it is run; play sets the input for the next frame.
+// Replaying a movie from power on reproduces the run exactly.
+class Movie {
+  public:
+    Movie();
+    ~Movie();
+
+    // Owns its runs, so it can't be copied
+    Movie(const Movie&) = delete;
+    Movie& operator=(const Movie&) = delete;
+
+    void clear();
+    uint32_t frames();
+
+    void record(uint8_t port1, uint8_t port2);
+    void record(Console& console);
+
+    // Playback. Once the movie runs out, play() leaves the buttons released
+    // and returns false.
+    void restart();
+    bool play(Console& console);
+
+    // Serialised form, same conventions as savestates
+    uint32_t size();
+    uint32_t save(uint8_t* buffer, uint32_t capacity);
+    bool load(const uint8_t* data, uint32_t size);
+
+  private:
+    struct Run {
+      uint32_t length;
+      uint8_t buttons[2];
+    };
+
+    Run* runs;
+    uint32_t runCount;
+    uint32_t runCapacity;
+    uint32_t frameCount;
+
+    uint32_t playRun;
+    uint32_t playFrame;
+
+    void append(uint32_t length, uint8_t port1, uint8_t port2);
+};
@@ -0,0 +1,262 @@
+#include "Opcodes.h"
+#include "Footprint.h"
+
+// mnemonic, addressing mode, length, cycles, page cross penalty, official
+CONST_DATA const OpcodeInfo OPCODES[256] = {
+  /* 00 */ { "BRK",  Implicit,    1, 7, 0, 1 },
+  /* 01 */ { "ORA",  IndirectX,   2, 6, 0, 1 },
+  /* 02 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* 03 */ { "SLO",  IndirectX,   2, 8, 0, 0 },
+  /* 04 */ { "NOP",  ZeroPage,    2, 3, 0, 0 },
+  /* 05 */ { "ORA",  ZeroPage,    2, 3, 0, 1 },
+  /* 06 */ { "ASL",  ZeroPage,    2, 5, 0, 1 },
+  /* 07 */ { "SLO",  ZeroPage,    2, 5, 0, 0 },
+  /* 08 */ { "PHP",  Implicit,    1, 3, 0, 1 },
+  /* 09 */ { "ORA",  Immediate,   2, 2, 0, 1 },
+  /* 0A */ { "ASL",  Accumulator, 1, 2, 0, 1 },
+  /* 0B */ { "ANC",  Immediate,   2, 2, 0, 0 },
+  /* 0C */ { "NOP",  Absolute,    3, 4, 0, 0 },
+  /* 0D */ { "ORA",  Absolute,    3, 4, 0, 1 },
+  /* 0E */ { "ASL",  Absolute,    3, 6, 0, 1 },
+  /* 0F */ { "SLO",  Absolute,    3, 6, 0, 0 },
+  /* 10 */ { "BPL",  Relative,    2, 2, 0, 1 },
+  /* 11 */ { "ORA",  IndirectY,   2, 5, 1, 1 },
+  /* 12 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* 13 */ { "SLO",  IndirectY,   2, 8, 0, 0 },
+  /* 14 */ { "NOP",  ZeroPageX,   2, 4, 0, 0 },
+  /* 15 */ { "ORA",  ZeroPageX,   2, 4, 0, 1 },
+  /* 16 */ { "ASL",  ZeroPageX,   2, 6, 0, 1 },
+  /* 17 */ { "SLO",  ZeroPageX,   2, 6, 0, 0 },
+  /* 18 */ { "CLC",  Implicit,    1, 2, 0, 1 },
+  /* 19 */ { "ORA",  AbsoluteY,   3, 4, 1, 1 },
+  /* 1A */ { "NOP",  Implicit,    1, 2, 0, 0 },
+  /* 1B */ { "SLO",  AbsoluteY,   3, 7, 0, 0 },
+  /* 1C */ { "NOP",  AbsoluteX,   3, 4, 1, 0 },
+  /* 1D */ { "ORA",  AbsoluteX,   3, 4, 1, 1 },
+  /* 1E */ { "ASL",  AbsoluteX,   3, 7, 0, 1 },
+  /* 1F */ { "SLO",  AbsoluteX,   3, 7, 0, 0 },
+  /* 20 */ { "JSR",  Absolute,    3, 6, 0, 1 },
+  /* 21 */ { "AND",  IndirectX,   2, 6, 0, 1 },
+  /* 22 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* 23 */ { "RLA",  IndirectX,   2, 8, 0, 0 },
+  /* 24 */ { "BIT",  ZeroPage,    2, 3, 0, 1 },
+  /* 25 */ { "AND",  ZeroPage,    2, 3, 0, 1 },
+  /* 26 */ { "ROL",  ZeroPage,    2, 5, 0, 1 },
+  /* 27 */ { "RLA",  ZeroPage,    2, 5, 0, 0 },
+  /* 28 */ { "PLP",  Implicit,    1, 4, 0, 1 },
+  /* 29 */ { "AND",  Immediate,   2, 2, 0, 1 },
+  /* 2A */ { "ROL",  Accumulator, 1, 2, 0, 1 },
+  /* 2B */ { "ANC",  Immediate,   2, 2, 0, 0 },
+  /* 2C */ { "BIT",  Absolute,    3, 4, 0, 1 },
+  /* 2D */ { "AND",  Absolute,    3, 4, 0, 1 },
+  /* 2E */ { "ROL",  Absolute,    3, 6, 0, 1 },
+  /* 2F */ { "RLA",  Absolute,    3, 6, 0, 0 },
+  /* 30 */ { "BMI",  Relative,    2, 2, 0, 1 },
+  /* 31 */ { "AND",  IndirectY,   2, 5, 1, 1 },
+  /* 32 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* 33 */ { "RLA",  IndirectY,   2, 8, 0, 0 },
+  /* 34 */ { "NOP",  ZeroPageX,   2, 4, 0, 0 },
+  /* 35 */ { "AND",  ZeroPageX,   2, 4, 0, 1 },
+  /* 36 */ { "ROL",  ZeroPageX,   2, 6, 0, 1 },
+  /* 37 */ { "RLA",  ZeroPageX,   2, 6, 0, 0 },
+  /* 38 */ { "SEC",  Implicit,    1, 2, 0, 1 },
+  /* 39 */ { "AND",  AbsoluteY,   3, 4, 1, 1 },
+  /* 3A */ { "NOP",  Implicit,    1, 2, 0, 0 },
+  /* 3B */ { "RLA",  AbsoluteY,   3, 7, 0, 0 },
+  /* 3C */ { "NOP",  AbsoluteX,   3, 4, 1, 0 },
+  /* 3D */ { "AND",  AbsoluteX,   3, 4, 1, 1 },
+  /* 3E */ { "ROL",  AbsoluteX,   3, 7, 0, 1 },
+  /* 3F */ { "RLA",  AbsoluteX,   3, 7, 0, 0 },
+  /* 40 */ { "RTI",  Implicit,    1, 6, 0, 1 },
+  /* 41 */ { "EOR",  IndirectX,   2, 6, 0, 1 },
+  /* 42 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* 43 */ { "SRE",  IndirectX,   2, 8, 0, 0 },
+  /* 44 */ { "NOP",  ZeroPage,    2, 3, 0, 0 },
+  /* 45 */ { "EOR",  ZeroPage,    2, 3, 0, 1 },
+  /* 46 */ { "LSR",  ZeroPage,    2, 5, 0, 1 },
+  /* 47 */ { "SRE",  ZeroPage,    2, 5, 0, 0 },
+  /* 48 */ { "PHA",  Implicit,    1, 3, 0, 1 },
+  /* 49 */ { "EOR",  Immediate,   2, 2, 0, 1 },
+  /* 4A */ { "LSR",  Accumulator, 1, 2, 0, 1 },
+  /* 4B */ { "ALR",  Immediate,   2, 2, 0, 0 },
+  /* 4C */ { "JMP",  Absolute,    3, 3, 0, 1 },
+  /* 4D */ { "EOR",  Absolute,    3, 4, 0, 1 },
+  /* 4E */ { "LSR",  Absolute,    3, 6, 0, 1 },
+  /* 4F */ { "SRE",  Absolute,    3, 6, 0, 0 },
+  /* 50 */ { "BVC",  Relative,    2, 2, 0, 1 },
+  /* 51 */ { "EOR",  IndirectY,   2, 5, 1, 1 },
+  /* 52 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* 53 */ { "SRE",  IndirectY,   2, 8, 0, 0 },
+  /* 54 */ { "NOP",  ZeroPageX,   2, 4, 0, 0 },
+  /* 55 */ { "EOR",  ZeroPageX,   2, 4, 0, 1 },
+  /* 56 */ { "LSR",  ZeroPageX,   2, 6, 0, 1 },
+  /* 57 */ { "SRE",  ZeroPageX,   2, 6, 0, 0 },
+  /* 58 */ { "CLI",  Implicit,    1, 2, 0, 1 },
+  /* 59 */ { "EOR",  AbsoluteY,   3, 4, 1, 1 },
+  /* 5A */ { "NOP",  Implicit,    1, 2, 0, 0 },
+  /* 5B */ { "SRE",  AbsoluteY,   3, 7, 0, 0 },
+  /* 5C */ { "NOP",  AbsoluteX,   3, 4, 1, 0 },
+  /* 5D */ { "EOR",  AbsoluteX,   3, 4, 1, 1 },
+  /* 5E */ { "LSR",  AbsoluteX,   3, 7, 0, 1 },
+  /* 5F */ { "SRE",  AbsoluteX,   3, 7, 0, 0 },
+  /* 60 */ { "RTS",  Implicit,    1, 6, 0, 1 },
+  /* 61 */ { "ADC",  IndirectX,   2, 6, 0, 1 },
+  /* 62 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* 63 */ { "RRA",  IndirectX,   2, 8, 0, 0 },
+  /* 64 */ { "NOP",  ZeroPage,    2, 3, 0, 0 },
+  /* 65 */ { "ADC",  ZeroPage,    2, 3, 0, 1 },
+  /* 66 */ { "ROR",  ZeroPage,    2, 5, 0, 1 },
+  /* 67 */ { "RRA",  ZeroPage,    2, 5, 0, 0 },
+  /* 68 */ { "PLA",  Implicit,    1, 4, 0, 1 },
+  /* 69 */ { "ADC",  Immediate,   2, 2, 0, 1 },
+  /* 6A */ { "ROR",  Accumulator, 1, 2, 0, 1 },
+  /* 6B */ { "ARR",  Immediate,   2, 2, 0, 0 },
+  /* 6C */ { "JMP",  Indirect,    3, 5, 0, 1 },
+  /* 6D */ { "ADC",  Absolute,    3, 4, 0, 1 },
+  /* 6E */ { "ROR",  Absolute,    3, 6, 0, 1 },
+  /* 6F */ { "RRA",  Absolute,    3, 6, 0, 0 },
+  /* 70 */ { "BVS",  Relative,    2, 2, 0, 1 },
+  /* 71 */ { "ADC",  IndirectY,   2, 5, 1, 1 },
+  /* 72 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* 73 */ { "RRA",  IndirectY,   2, 8, 0, 0 },
+  /* 74 */ { "NOP",  ZeroPageX,   2, 4, 0, 0 },
+  /* 75 */ { "ADC",  ZeroPageX,   2, 4, 0, 1 },
+  /* 76 */ { "ROR",  ZeroPageX,   2, 6, 0, 1 },
+  /* 77 */ { "RRA",  ZeroPageX,   2, 6, 0, 0 },
+  /* 78 */ { "SEI",  Implicit,    1, 2, 0, 1 },
+  /* 79 */ { "ADC",  AbsoluteY,   3, 4, 1, 1 },
+  /* 7A */ { "NOP",  Implicit,    1, 2, 0, 0 },
+  /* 7B */ { "RRA",  AbsoluteY,   3, 7, 0, 0 },
+  /* 7C */ { "NOP",  AbsoluteX,   3, 4, 1, 0 },
+  /* 7D */ { "ADC",  AbsoluteX,   3, 4, 1, 1 },
+  /* 7E */ { "ROR",  AbsoluteX,   3, 7, 0, 1 },
+  /* 7F */ { "RRA",  AbsoluteX,   3, 7, 0, 0 },
+  /* 80 */ { "NOP",  Immediate,   2, 2, 0, 0 },
+  /* 81 */ { "STA",  IndirectX,   2, 6, 0, 1 },
+  /* 82 */ { "NOP",  Immediate,   2, 2, 0, 0 },
+  /* 83 */ { "SAX",  IndirectX,   2, 6, 0, 0 },
+  /* 84 */ { "STY",  ZeroPage,    2, 3, 0, 1 },
+  /* 85 */ { "STA",  ZeroPage,    2, 3, 0, 1 },
+  /* 86 */ { "STX",  ZeroPage,    2, 3, 0, 1 },
+  /* 87 */ { "SAX",  ZeroPage,    2, 3, 0, 0 },
+  /* 88 */ { "DEY",  Implicit,    1, 2, 0, 1 },
+  /* 89 */ { "NOP",  Immediate,   2, 2, 0, 0 },
+  /* 8A */ { "TXA",  Implicit,    1, 2, 0, 1 },
+  /* 8B */ { "ANE",  Immediate,   2, 2, 0, 0 },
+  /* 8C */ { "STY",  Absolute,    3, 4, 0, 1 },
+  /* 8D */ { "STA",  Absolute,    3, 4, 0, 1 },
+  /* 8E */ { "STX",  Absolute,    3, 4, 0, 1 },
+  /* 8F */ { "SAX",  Absolute,    3, 4, 0, 0 },
+  /* 90 */ { "BCC",  Relative,    2, 2, 0, 1 },
+  /* 91 */ { "STA",  IndirectY,   2, 6, 0, 1 },
+  /* 92 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* 93 */ { "SHA",  IndirectY,   2, 6, 0, 0 },
+  /* 94 */ { "STY",  ZeroPageX,   2, 4, 0, 1 },
+  /* 95 */ { "STA",  ZeroPageX,   2, 4, 0, 1 },
+  /* 96 */ { "STX",  ZeroPageY,   2, 4, 0, 1 },
+  /* 97 */ { "SAX",  ZeroPageY,   2, 4, 0, 0 },
+  /* 98 */ { "TYA",  Implicit,    1, 2, 0, 1 },
+  /* 99 */ { "STA",  AbsoluteY,   3, 5, 0, 1 },
+  /* 9A */ { "TXS",  Implicit,    1, 2, 0, 1 },
+  /* 9B */ { "TAS",  AbsoluteY,   3, 5, 0, 0 },
+  /* 9C */ { "SHY",  AbsoluteX,   3, 5, 0, 0 },
+  /* 9D */ { "STA",  AbsoluteX,   3, 5, 0, 1 },
+  /* 9E */ { "SHX",  AbsoluteY,   3, 5, 0, 0 },
+  /* 9F */ { "SHA",  AbsoluteY,   3, 5, 0, 0 },
+  /* A0 */ { "LDY",  Immediate,   2, 2, 0, 1 },
+  /* A1 */ { "LDA",  IndirectX,   2, 6, 0, 1 },
+  /* A2 */ { "LDX",  Immediate,   2, 2, 0, 1 },
+  /* A3 */ { "LAX",  IndirectX,   2, 6, 0, 0 },
+  /* A4 */ { "LDY",  ZeroPage,    2, 3, 0, 1 },
+  /* A5 */ { "LDA",  ZeroPage,    2, 3, 0, 1 },
+  /* A6 */ { "LDX",  ZeroPage,    2, 3, 0, 1 },
+  /* A7 */ { "LAX",  ZeroPage,    2, 3, 0, 0 },
+  /* A8 */ { "TAY",  Implicit,    1, 2, 0, 1 },
+  /* A9 */ { "LDA",  Immediate,   2, 2, 0, 1 },
+  /* AA */ { "TAX",  Implicit,    1, 2, 0, 1 },
+  /* AB */ { "LXA",  Immediate,   2, 2, 0, 0 },
+  /* AC */ { "LDY",  Absolute,    3, 4, 0, 1 },
+  /* AD */ { "LDA",  Absolute,    3, 4, 0, 1 },
+  /* AE */ { "LDX",  Absolute,    3, 4, 0, 1 },
+  /* AF */ { "LAX",  Absolute,    3, 4, 0, 0 },
+  /* B0 */ { "BCS",  Relative,    2, 2, 0, 1 },
+  /* B1 */ { "LDA",  IndirectY,   2, 5, 1, 1 },
+  /* B2 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* B3 */ { "LAX",  IndirectY,   2, 5, 1, 0 },
+  /* B4 */ { "LDY",  ZeroPageX,   2, 4, 0, 1 },
+  /* B5 */ { "LDA",  ZeroPageX,   2, 4, 0, 1 },
+  /* B6 */ { "LDX",  ZeroPageY,   2, 4, 0, 1 },
+  /* B7 */ { "LAX",  ZeroPageY,   2, 4, 0, 0 },
+  /* B8 */ { "CLV",  Implicit,    1, 2, 0, 1 },
+  /* B9 */ { "LDA",  AbsoluteY,   3, 4, 1, 1 },
+  /* BA */ { "TSX",  Implicit,    1, 2, 0, 1 },
+  /* BB */ { "LAS",  AbsoluteY,   3, 4, 1, 0 },
+  /* BC */ { "LDY",  AbsoluteX,   3, 4, 1, 1 },
+  /* BD */ { "LDA",  AbsoluteX,   3, 4, 1, 1 },
+  /* BE */ { "LDX",  AbsoluteY,   3, 4, 1, 1 },
+  /* BF */ { "LAX",  AbsoluteY,   3, 4, 1, 0 },
+  /* C0 */ { "CPY",  Immediate,   2, 2, 0, 1 },
+  /* C1 */ { "CMP",  IndirectX,   2, 6, 0, 1 },
+  /* C2 */ { "NOP",  Immediate,   2, 2, 0, 0 },
+  /* C3 */ { "DCP",  IndirectX,   2, 8, 0, 0 },
+  /* C4 */ { "CPY",  ZeroPage,    2, 3, 0, 1 },
+  /* C5 */ { "CMP",  ZeroPage,    2, 3, 0, 1 },
+  /* C6 */ { "DEC",  ZeroPage,    2, 5, 0, 1 },
+  /* C7 */ { "DCP",  ZeroPage,    2, 5, 0, 0 },
+  /* C8 */ { "INY",  Implicit,    1, 2, 0, 1 },
+  /* C9 */ { "CMP",  Immediate,   2, 2, 0, 1 },
+  /* CA */ { "DEX",  Implicit,    1, 2, 0, 1 },
+  /* CB */ { "SBX",  Immediate,   2, 2, 0, 0 },
+  /* CC */ { "CPY",  Absolute,    3, 4, 0, 1 },
+  /* CD */ { "CMP",  Absolute,    3, 4, 0, 1 },
+  /* CE */ { "DEC",  Absolute,    3, 6, 0, 1 },
+  /* CF */ { "DCP",  Absolute,    3, 6, 0, 0 },
+  /* D0 */ { "BNE",  Relative,    2, 2, 0, 1 },
+  /* D1 */ { "CMP",  IndirectY,   2, 5, 1, 1 },
+  /* D2 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* D3 */ { "DCP",  IndirectY,   2, 8, 0, 0 },
+  /* D4 */ { "NOP",  ZeroPageX,   2, 4, 0, 0 },
+  /* D5 */ { "CMP",  ZeroPageX,   2, 4, 0, 1 },
+  /* D6 */ { "DEC",  ZeroPageX,   2, 6, 0, 1 },
+  /* D7 */ { "DCP",  ZeroPageX,   2, 6, 0, 0 },
+  /* D8 */ { "CLD",  Implicit,    1, 2, 0, 1 },
+  /* D9 */ { "CMP",  AbsoluteY,   3, 4, 1, 1 },
+  /* DA */ { "NOP",  Implicit,    1, 2, 0, 0 },
+  /* DB */ { "DCP",  AbsoluteY,   3, 7, 0, 0 },
+  /* DC */ { "NOP",  AbsoluteX,   3, 4, 1, 0 },
+  /* DD */ { "CMP",  AbsoluteX,   3, 4, 1, 1 },
+  /* DE */ { "DEC",  AbsoluteX,   3, 7, 0, 1 },
+  /* DF */ { "DCP",  AbsoluteX,   3, 7, 0, 0 },
+  /* E0 */ { "CPX",  Immediate,   2, 2, 0, 1 },
+  /* E1 */ { "SBC",  IndirectX,   2, 6, 0, 1 },
+  /* E2 */ { "NOP",  Immediate,   2, 2, 0, 0 },
+  /* E3 */ { "ISC",  IndirectX,   2, 8, 0, 0 },
+  /* E4 */ { "CPX",  ZeroPage,    2, 3, 0, 1 },
+  /* E5 */ { "SBC",  ZeroPage,    2, 3, 0, 1 },
+  /* E6 */ { "INC",  ZeroPage,    2, 5, 0, 1 },
+  /* E7 */ { "ISC",  ZeroPage,    2, 5, 0, 0 },
+  /* E8 */ { "INX",  Implicit,    1, 2, 0, 1 },
+  /* E9 */ { "SBC",  Immediate,   2, 2, 0, 1 },
+  /* EA */ { "NOP",  Implicit,    1, 2, 0, 1 },
+  /* EB */ { "USBC", Immediate,   2, 2, 0, 0 },
+  /* EC */ { "CPX",  Absolute,    3, 4, 0, 1 },
+  /* ED */ { "SBC",  Absolute,    3, 4, 0, 1 },
+  /* EE */ { "INC",  Absolute,    3, 6, 0, 1 },
+  /* EF */ { "ISC",  Absolute,    3, 6, 0, 0 },
+  /* F0 */ { "BEQ",  Relative,    2, 2, 0, 1 },
+  /* F1 */ { "SBC",  IndirectY,   2, 5, 1, 1 },
+  /* F2 */ { "JAM",  Implicit,    1, 2, 0, 0 },
+  /* F3 */ { "ISC",  IndirectY,   2, 8, 0, 0 },
+  /* F4 */ { "NOP",  ZeroPageX,   2, 4, 0, 0 },
+  /* F5 */ { "SBC",  ZeroPageX,   2, 4, 0, 1 },
+  /* F6 */ { "INC",  ZeroPageX,   2, 6, 0, 1 },
+  /* F7 */ { "ISC",  ZeroPageX,   2, 6, 0, 0 },
+  /* F8 */ { "SED",  Implicit,    1, 2, 0, 1 },
+  /* F9 */ { "SBC",  AbsoluteY,   3, 4, 1, 1 },
+  /* FA */ { "NOP",  Implicit,    1, 2, 0, 0 },
+  /* FB */ { "ISC",  AbsoluteY,   3, 7, 0, 0 },
+  /* FC */ { "NOP",  AbsoluteX,   3, 4, 1, 0 },
+  /* FD */ { "SBC",  AbsoluteX,   3, 4, 1, 1 },
+  /* FE */ { "INC",  AbsoluteX,   3, 7, 0, 1 },
+  /* FF */ { "ISC",  AbsoluteX,   3, 7, 0, 0 },
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include "CPU.h"
+
+// Reference description of every NMOS 6502 opcode, official or not.
+// `cycles` is the base cost; `pageCross` is set when crossing a page while
+// indexing adds a cycle (read instructions on abs,X / abs,Y / (ind),Y).
+struct OpcodeInfo {
+  const char* mnemonic;
+  AddressingMode mode;
+  uint8_t length;
+  uint8_t cycles;
+  uint8_t pageCross;
+  uint8_t official;
+};
+
+extern const OpcodeInfo OPCODES[256];
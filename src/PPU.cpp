@@ -0,0 +1,374 @@
+#include <string.h>
+#include "CPU.h"
+#include "PPU.h"
+#include "Cartridge.h"
+#include "Footprint.h"
+
+PPU::PPU() : framebuffer(framebufferData), skipRender(0), cart(0) {
+  reset();
+  mapNametables();
+}
+
+PPU::~PPU() {}
+
+void PPU::connectToCartridge(Cartridge* c) {
+  cart = c;
+  (*cart).connectToPPU(this);
+  mapNametables();
+}
+
+void PPU::mapNametables() {
+  Mirroring mirroring = cart ? (*cart).mirroring : Horizontal;
+  uint8_t* low = &vram[0];
+  uint8_t* high = &vram[NAMETABLE_SIZE];
+
+  switch (mirroring) {
+    case Vertical:
+      nametables[0] = nametables[2] = low;
+      nametables[1] = nametables[3] = high;
+      break;
+    case SingleScreenLow:
+      nametables[0] = nametables[1] = nametables[2] = nametables[3] = low;
+      break;
+    case SingleScreenHigh:
+      nametables[0] = nametables[1] = nametables[2] = nametables[3] = high;
+      break;
+    case FourScreen:
+      nametables[0] = low;
+      nametables[1] = high;
+      nametables[2] = &(*cart).nametableRam[0];
+      nametables[3] = &(*cart).nametableRam[NAMETABLE_SIZE];
+      break;
+    default:
+      nametables[0] = nametables[1] = low;
+      nametables[2] = nametables[3] = high;
+      break;
+  }
+}
+
+void PPU::reset() {
+  ctrl = 0;
+  mask = 0;
+  status = 0;
+  oamAddress = 0;
+  v = 0;
+  t = 0;
+  fineX = 0;
+  w = 0;
+  readBuffer = 0;
+  scanline = 0;
+  dot = 0;
+  oddFrame = 0;
+  nmiPending = 0;
+  frameComplete = 0;
+  frame = 0;
+  memset(reserved, 0, sizeof(reserved));
+
+  memset(vram, 0, sizeof(vram));
+  memset(palette, 0, sizeof(palette));
+  memset(oam, 0, sizeof(oam));
+  memset(framebuffer, 0, FRAMEBUFFER_SIZE);
+}
+
+// CPU side
+HOT_CODE uint8_t PPU::readRegister(uint16_t address) {
+  switch (address & 7) {
+    case 2: {
+      uint8_t value = (status & 0xe0) | (readBuffer & 0x1f);
+      CLEAR_BIT(status, STATUS_VBLANK_BIT);
+      w = 0;
+      return value;
+    }
+    case 4: return oam[oamAddress];
+    case 7: {
+      uint8_t value;
+      if ((v & 0x3fff) >= 0x3f00) {
+        // Palette reads aren't buffered, but still fill the buffer from the
+        // nametable "underneath" the palette
+        value = read(v);
+        readBuffer = read(v - 0x1000);
+      } else {
+        value = readBuffer;
+        readBuffer = read(v);
+      }
+      v += BIT_VALUE(ctrl, CTRL_INCREMENT_BIT) ? 32 : 1;
+      return value;
+    }
+    default: return 0;
+  }
+}
+
+HOT_CODE void PPU::writeRegister(uint16_t address, uint8_t value) {
+  switch (address & 7) {
+    case 0: {
+      // Enabling NMI during vblank triggers one immediately
+      if (!BIT_VALUE(ctrl, CTRL_NMI_BIT) && BIT_VALUE(value, CTRL_NMI_BIT) && BIT_VALUE(status, STATUS_VBLANK_BIT)) {
+        nmiPending = 1;
+      }
+      ctrl = value;
+      t = (t & 0xf3ff) | ((value & 0x03) << 10);
+      break;
+    }
+    case 1: mask = value; break;
+    case 3: oamAddress = value; break;
+    case 4: oam[oamAddress++] = value; break;
+    case 5: {
+      if (w == 0) {
+        t = (t & 0xffe0) | (value >> 3);
+        fineX = value & 0x07;
+      } else {
+        t = (t & 0x8c1f) | ((value & 0x07) << 12) | ((value & 0xf8) << 2);
+      }
+      w ^= 1;
+      break;
+    }
+    case 6: {
+      if (w == 0) {
+        t = (t & 0x00ff) | ((value & 0x3f) << 8);
+      } else {
+        t = (t & 0xff00) | value;
+        v = t;
+      }
+      w ^= 1;
+      break;
+    }
+    case 7: {
+      write(v, value);
+      v += BIT_VALUE(ctrl, CTRL_INCREMENT_BIT) ? 32 : 1;
+      break;
+    }
+    default: break;
+  }
+}
+
+// PPU address space. $3000-$3EFF mirrors the nametables.
+
+uint8_t PPU::read(uint16_t address) {
+  address &= 0x3fff;
+  if (address < 0x2000) return (*cart).readCHR(address);
+  if (address < 0x3f00) return nametables[(address >> 10) & 0x03][address & 0x03ff];
+
+  uint8_t index = address & 0x1f;
+  if ((index & 0x13) == 0x10) index &= 0x0f;
+  return palette[index];
+}
+
+void PPU::write(uint16_t address, uint8_t value) {
+  address &= 0x3fff;
+  if (address < 0x2000) {
+    (*cart).writeCHR(address, value);
+  } else if (address < 0x3f00) {
+    nametables[(address >> 10) & 0x03][address & 0x03ff] = value;
+  } else {
+    uint8_t index = address & 0x1f;
+    if ((index & 0x13) == 0x10) index &= 0x0f;
+    palette[index] = value & 0x3f;
+  }
+}
+
+// Timing
+HOT_CODE void PPU::tick(uint32_t cpuCycles) {
+  dot += cpuCycles * 3;
+
+  while (true) {
+    // The pre-render line is one dot shorter on odd frames while rendering
+    uint16_t length = DOTS_PER_SCANLINE;
+    bool rendering = mask & ((1 << MASK_BG_BIT) | (1 << MASK_SPRITE_BIT));
+    if (scanline == PRERENDER_SCANLINE && oddFrame && rendering) length--;
+
+    if (dot < length) break;
+    dot -= length;
+    finishScanline();
+  }
+}
+
+HOT_CODE void PPU::finishScanline() {
+  bool rendering = mask & ((1 << MASK_BG_BIT) | (1 << MASK_SPRITE_BIT));
+
+  if (scanline < SCREEN_HEIGHT) {
+    renderScanline();
+    if (rendering) {
+      incrementY();
+      copyX();
+    }
+  } else if (scanline == PRERENDER_SCANLINE && rendering) {
+    copyY();
+    copyX();
+  }
+
+  scanline++;
+
+  if (scanline == VBLANK_SCANLINE) {
+    SET_BIT(status, STATUS_VBLANK_BIT);
+    if (BIT_VALUE(ctrl, CTRL_NMI_BIT)) nmiPending = 1;
+  } else if (scanline == PRERENDER_SCANLINE) {
+    status &= ~((1 << STATUS_VBLANK_BIT) | (1 << STATUS_SPRITE0_BIT) | (1 << STATUS_OVERFLOW_BIT));
+  } else if (scanline > PRERENDER_SCANLINE) {
+    scanline = 0;
+    oddFrame ^= 1;
+    frameComplete = 1;
+    frame++;
+  }
+}
+
+// Rendering
+HOT_CODE void PPU::renderScanline() {
+  uint8_t* line = &framebuffer[scanline * SCREEN_WIDTH];
+  uint8_t background[SCREEN_WIDTH + 16];
+  uint8_t sprites[SCREEN_WIDTH];
+
+  memset(background, 0, sizeof(background));
+  memset(sprites, 0, sizeof(sprites));
+
+  uint8_t height = BIT_VALUE(ctrl, CTRL_SPRITE_SIZE_BIT) ? 16 : 8;
+
+  // Hidden frames only need the sprite 0 hit and overflow flags, so only the
+  // background tiles under sprite 0 are fetched and nothing is composed
+  int firstTile = 0;
+  int lastTile = 32;
+  if (skipRender) {
+    int row = scanline - 1 - oam[0];
+    if (BIT_VALUE(status, STATUS_SPRITE0_BIT) || !BIT_VALUE(mask, MASK_SPRITE_BIT) || row < 0 || row >= height) {
+      lastTile = -1;
+    } else {
+      firstTile = (oam[3] + fineX) >> 3;
+      lastTile = (oam[3] + fineX + 7) >> 3;
+      if (lastTile > 32) lastTile = 32;
+    }
+  }
+
+  if (BIT_VALUE(mask, MASK_BG_BIT) && lastTile >= 0) {
+    uint16_t address = v;
+    uint16_t patternTable = BIT_VALUE(ctrl, CTRL_BG_TABLE) ? 0x1000 : 0;
+    uint16_t fineY = (address >> 12) & 0x07;
+
+    // 33 tiles cover the line for any fine X scroll
+    for (int tile = 0; tile <= lastTile; tile++) {
+      if (tile >= firstTile) {
+        const uint8_t* nametable = nametables[(address >> 10) & 0x03];
+        uint8_t index = nametable[address & 0x03ff];
+        uint8_t attribute = nametable[0x03c0 | ((address >> 4) & 0x38) | ((address >> 2) & 0x07)];
+        uint8_t shift = ((address >> 4) & 0x04) | (address & 0x02);
+        uint8_t paletteBits = ((attribute >> shift) & 0x03) << 2;
+
+        uint8_t low = read(patternTable + index * 16 + fineY);
+        uint8_t high = read(patternTable + index * 16 + fineY + 8);
+
+        for (int bit = 0; bit < 8; bit++) {
+          uint8_t color = ((low >> (7 - bit)) & 0x01) | (((high >> (7 - bit)) & 0x01) << 1);
+          background[tile * 8 + bit] = color ? (paletteBits | color) : 0;
+        }
+      }
+
+      // Increment coarse X, switching horizontal nametable on wrap
+      if ((address & 0x001f) == 31) {
+        address &= ~0x001f;
+        address ^= 0x0400;
+      } else {
+        address++;
+      }
+    }
+
+    if (!BIT_VALUE(mask, MASK_BG_LEFT_BIT)) {
+      memset(&background[fineX], 0, 8);
+    }
+  }
+
+  if (BIT_VALUE(mask, MASK_SPRITE_BIT)) {
+    int found = 0;
+
+    for (int i = 0; i < 64; i++) {
+      uint8_t* sprite = &oam[i * 4];
+      int row = scanline - 1 - sprite[0];
+      if (row < 0 || row >= height) continue;
+
+      if (found == 8) {
+        SET_BIT(status, STATUS_OVERFLOW_BIT);
+        break;
+      }
+      found++;
+      if (skipRender && i != 0) continue;
+
+      uint8_t tile = sprite[1];
+      uint8_t attributes = sprite[2];
+      if (attributes & 0x80) row = height - 1 - row;
+
+      uint16_t patternAddress;
+      if (height == 16) {
+        patternAddress = ((tile & 0x01) << 12) | ((tile & 0xfe) << 4);
+        if (row >= 8) {
+          patternAddress += 16;
+          row -= 8;
+        }
+      } else {
+        patternAddress = (BIT_VALUE(ctrl, CTRL_SPRITE_TABLE) ? 0x1000 : 0) | (tile << 4);
+      }
+
+      uint8_t low = read(patternAddress + row);
+      uint8_t high = read(patternAddress + row + 8);
+      uint8_t flipX = attributes & 0x40;
+
+      for (int bit = 0; bit < 8; bit++) {
+        int x = sprite[3] + bit;
+        if (x >= SCREEN_WIDTH) break;
+        if (x < 8 && !BIT_VALUE(mask, MASK_SPRITE_LEFT_BIT)) continue;
+
+        int shift = flipX ? bit : 7 - bit;
+        uint8_t color = ((low >> shift) & 0x01) | (((high >> shift) & 0x01) << 1);
+        if (color == 0) continue;
+
+        if (i == 0 && x != 255 && background[x + fineX]) {
+          SET_BIT(status, STATUS_SPRITE0_BIT);
+        }
+
+        // Earlier sprites win, regardless of their priority bit
+        if (sprites[x] == 0) {
+          sprites[x] = 0x80 | ((attributes & 0x20) << 1) | 0x10 | ((attributes & 0x03) << 2) | color;
+        }
+      }
+    }
+  }
+
+  if (skipRender) return;
+
+  uint8_t grayscale = BIT_VALUE(mask, MASK_GRAYSCALE_BIT) ? 0x30 : 0x3f;
+  for (int x = 0; x < SCREEN_WIDTH; x++) {
+    uint8_t bg = background[x + fineX];
+    uint8_t sprite = sprites[x];
+    uint8_t index = bg;
+
+    // Bit 7 marks an opaque sprite pixel, bit 6 puts it behind the background
+    if (sprite && (bg == 0 || !(sprite & 0x40))) {
+      index = sprite & 0x1f;
+    }
+
+    line[x] = palette[index & 0x03 ? index : 0] & grayscale;
+  }
+}
+
+void PPU::incrementY() {
+  if ((v & 0x7000) != 0x7000) {
+    v += 0x1000;
+    return;
+  }
+
+  v &= ~0x7000;
+  uint16_t coarseY = (v & 0x03e0) >> 5;
+  if (coarseY == 29) {
+    coarseY = 0;
+    v ^= 0x0800;
+  } else if (coarseY == 31) {
+    coarseY = 0;
+  } else {
+    coarseY++;
+  }
+  v = (v & ~0x03e0) | (coarseY << 5);
+}
+
+void PPU::copyX() {
+  v = (v & ~0x041f) | (t & 0x041f);
+}
+
+void PPU::copyY() {
+  v = (v & ~0x7be0) | (t & 0x7be0);
+}
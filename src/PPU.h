@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+
+#define SCREEN_WIDTH 256
+#define SCREEN_HEIGHT 240
+#define FRAMEBUFFER_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT)
+
+#define DOTS_PER_SCANLINE 341
+#define VBLANK_SCANLINE 241
+#define PRERENDER_SCANLINE 261
+
+// NTSC frame rate, 60.0988 Hz
+#define FRAME_RATE_NUM 39375000
+#define FRAME_RATE_DEN 655171
+
+#define VRAM_SIZE 1024 * 2
+#define PALETTE_SIZE 32
+#define OAM_SIZE 256
+
+// PPUCTRL
+#define CTRL_INCREMENT_BIT   2
+#define CTRL_SPRITE_TABLE    3
+#define CTRL_BG_TABLE        4
+#define CTRL_SPRITE_SIZE_BIT 5
+#define CTRL_NMI_BIT         7
+
+// PPUMASK
+#define MASK_GRAYSCALE_BIT   0
+#define MASK_BG_LEFT_BIT     1
+#define MASK_SPRITE_LEFT_BIT 2
+#define MASK_BG_BIT          3
+#define MASK_SPRITE_BIT      4
+
+// PPUSTATUS
+#define STATUS_OVERFLOW_BIT  5
+#define STATUS_SPRITE0_BIT   6
+#define STATUS_VBLANK_BIT    7
+
+class Cartridge;
+
+// Register, timing and memory state of the PPU, kept in one plain block so
+// savestates can copy it. Widest fields first and explicit reserved bytes,
+// so there is no padding.
+struct PPUState {
+  uint64_t frame;
+
+  // Internal scroll registers ("loopy" v, t, x and w)
+  uint16_t v;
+  uint16_t t;
+
+  uint16_t scanline;
+  uint16_t dot;
+
+  uint8_t ctrl;
+  uint8_t mask;
+  uint8_t status;
+  uint8_t oamAddress;
+  uint8_t fineX;
+  uint8_t w;
+  uint8_t readBuffer;
+  uint8_t oddFrame;
+  uint8_t nmiPending;
+  uint8_t frameComplete;
+  uint8_t reserved[6];
+
+  uint8_t vram[VRAM_SIZE];
+  uint8_t palette[PALETTE_SIZE];
+  uint8_t oam[OAM_SIZE];
+};
+
+static_assert(sizeof(PPUState) == 32 + VRAM_SIZE + PALETTE_SIZE + OAM_SIZE, "PPUState must not have padding");
+
+// Scanline based PPU. Each visible scanline is drawn in one go when the PPU
+// reaches its end, using the scroll registers as they were at that point.
+// The framebuffer holds 6-bit NES colour indices.
+class PPU : public PPUState {
+  public:
+    PPU();
+    ~PPU();
+
+    // Where frames are drawn: framebufferData, unless the owner points it
+    // at a buffer of its own (see Env.h)
+    uint8_t* framebuffer;
+    uint8_t framebufferData[FRAMEBUFFER_SIZE];
+
+    // Leave the framebuffer alone and only keep the sprite 0 hit and
+    // overflow flags right, for frames that are never shown
+    uint8_t skipRender;
+
+    void connectToCartridge(Cartridge* c);
+    void reset();
+
+    // CPU side, $2000-$2007 (mirrored up to $3FFF)
+    uint8_t readRegister(uint16_t address);
+    void writeRegister(uint16_t address, uint8_t value);
+
+    // Advance by the given number of CPU cycles (3 dots each)
+    void tick(uint32_t cpuCycles);
+
+    // Point the nametable table at VRAM for the cartridge's mirroring
+    void mapNametables();
+
+  private:
+    Cartridge* cart;
+
+    // Where each of the four nametables at $2000-$2FFF lives, so accesses
+    // never look at the mirroring mode
+    uint8_t* nametables[4];
+
+    uint8_t read(uint16_t address);
+    void write(uint16_t address, uint8_t value);
+
+    void finishScanline();
+    void renderScanline();
+    void incrementY();
+    void copyX();
+    void copyY();
+};
@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <string.h>
+#include "Profile.h"
+#include "Opcodes.h"
+
+#define REPORT_PAGES 16
+#define REPORT_LOOPS 16
+#define PRG_WINDOW_SIZE 0x2000
+
+#ifdef CPU_PROFILE
+
+uint64_t OpcodeProfile::executions[256];
+uint64_t OpcodeProfile::cycles[256];
+uint64_t OpcodeProfile::pageCrosses[256];
+uint64_t OpcodeProfile::cycleHistogram[PROFILE_MAX_CYCLES];
+uint64_t OpcodeProfile::reads[PROFILE_PAGES];
+uint64_t OpcodeProfile::writes[PROFILE_PAGES];
+
+static const char* MODE_NAMES[] = {
+  "imp", "acc", "imm", "zp", "zp,x", "zp,y", "rel", "abs", "abs,x", "abs,y", "ind", "(ind,x)", "(ind),y"
+};
+
+uint8_t OpcodeProfile::crossed(uint8_t opcode, uint8_t taken) {
+  const OpcodeInfo& info = OPCODES[opcode];
+  if (info.mode == Relative) return taken == info.cycles + 2;
+  return taken > info.cycles;
+}
+
+void OpcodeProfile::reset() {
+  memset(executions, 0, sizeof(executions));
+  memset(cycles, 0, sizeof(cycles));
+  memset(pageCrosses, 0, sizeof(pageCrosses));
+  memset(cycleHistogram, 0, sizeof(cycleHistogram));
+  memset(reads, 0, sizeof(reads));
+  memset(writes, 0, sizeof(writes));
+}
+
+static int byCycles(const void* a, const void* b) {
+  uint64_t x = OpcodeProfile::cycles[*(const uint8_t*)a];
+  uint64_t y = OpcodeProfile::cycles[*(const uint8_t*)b];
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static int byAccesses(const void* a, const void* b) {
+  int i = *(const uint8_t*)a;
+  int j = *(const uint8_t*)b;
+  uint64_t x = OpcodeProfile::reads[i] + OpcodeProfile::writes[i];
+  uint64_t y = OpcodeProfile::reads[j] + OpcodeProfile::writes[j];
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+void OpcodeProfile::report(FILE* out) {
+  uint64_t totalExecutions = 0;
+  uint64_t totalCycles = 0;
+  for (int i = 0; i < 256; i++) {
+    totalExecutions += executions[i];
+    totalCycles += cycles[i];
+  }
+  if (totalExecutions == 0) return;
+
+  uint8_t order[256];
+  for (int i = 0; i < 256; i++) order[i] = i;
+  qsort(order, 256, 1, byCycles);
+
+  fprintf(out, "%llu instructions, %llu cycles\n\n", (unsigned long long)totalExecutions, (unsigned long long)totalCycles);
+  fprintf(out, "op  mnemonic mode         count  %%count       cycles %%cycles  avg  crosses\n");
+  for (int i = 0; i < 256 && executions[order[i]]; i++) {
+    uint8_t op = order[i];
+    const OpcodeInfo& info = OPCODES[op];
+    fprintf(out, "%02X  %-8s %-8s %12llu %6.2f%% %12llu %6.2f%% %4.2f %8llu\n",
+      op, info.mnemonic, MODE_NAMES[info.mode],
+      (unsigned long long)executions[op], 100.0 * executions[op] / totalExecutions,
+      (unsigned long long)cycles[op], 100.0 * cycles[op] / totalCycles,
+      (double)cycles[op] / executions[op], (unsigned long long)pageCrosses[op]);
+  }
+
+  fprintf(out, "\ncycles  instructions\n");
+  for (int i = 0; i < PROFILE_MAX_CYCLES; i++) {
+    if (cycleHistogram[i]) fprintf(out, "%6d  %12llu\n", i, (unsigned long long)cycleHistogram[i]);
+  }
+
+  uint8_t pages[PROFILE_PAGES];
+  for (int i = 0; i < PROFILE_PAGES; i++) pages[i] = i;
+  qsort(pages, PROFILE_PAGES, 1, byAccesses);
+
+  fprintf(out, "\npage          reads       writes\n");
+  for (int i = 0; i < REPORT_PAGES && reads[pages[i]] + writes[pages[i]]; i++) {
+    fprintf(out, "$%02X00  %12llu %12llu\n", pages[i], (unsigned long long)reads[pages[i]], (unsigned long long)writes[pages[i]]);
+  }
+}
+
+#endif
+
+#ifdef CPU_HEATMAP
+
+#define HEATMAP_VERSION 1
+
+uint64_t Heatmap::executions[ADDRESS_SPACE];
+uint64_t Heatmap::reads[ADDRESS_SPACE];
+uint64_t Heatmap::writes[ADDRESS_SPACE];
+uint64_t Heatmap::loopTrips[ADDRESS_SPACE];
+uint16_t Heatmap::loopTargets[ADDRESS_SPACE];
+
+void Heatmap::reset() {
+  memset(executions, 0, sizeof(executions));
+  memset(reads, 0, sizeof(reads));
+  memset(writes, 0, sizeof(writes));
+  memset(loopTrips, 0, sizeof(loopTrips));
+  memset(loopTargets, 0, sizeof(loopTargets));
+}
+
+bool Heatmap::exportCSV(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (!f) return false;
+
+  fprintf(f, "address,executions,reads,writes\n");
+  for (uint32_t i = 0; i < ADDRESS_SPACE; i++) {
+    if (executions[i] | reads[i] | writes[i]) {
+      fprintf(f, "%04X,%llu,%llu,%llu\n", i, (unsigned long long)executions[i], (unsigned long long)reads[i], (unsigned long long)writes[i]);
+    }
+  }
+
+  return fclose(f) == 0;
+}
+
+bool Heatmap::exportBinary(const char* path) {
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+
+  HeatmapHeader header = { { 'T', 'N', 'H', 'M' }, HEATMAP_VERSION, ADDRESS_SPACE, 3 };
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+    && fwrite(executions, sizeof(executions), 1, f) == 1
+    && fwrite(reads, sizeof(reads), 1, f) == 1
+    && fwrite(writes, sizeof(writes), 1, f) == 1;
+
+  return fclose(f) == 0 && ok;
+}
+
+// Branch addresses with a taken backward branch, most trips first
+static uint32_t rankLoops(uint16_t* loops) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < ADDRESS_SPACE; i++) {
+    if (Heatmap::loopTrips[i]) loops[count++] = i;
+  }
+
+  qsort(loops, count, sizeof(uint16_t), [](const void* a, const void* b) {
+    uint64_t x = Heatmap::loopTrips[*(const uint16_t*)a];
+    uint64_t y = Heatmap::loopTrips[*(const uint16_t*)b];
+    return x < y ? 1 : x > y ? -1 : 0;
+  });
+  return count;
+}
+
+bool Heatmap::exportLoops(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (!f) return false;
+
+  uint16_t* loops = new uint16_t[ADDRESS_SPACE];
+  uint32_t count = rankLoops(loops);
+
+  fprintf(f, "target,branch,trips,executions\n");
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t branch = loops[i];
+    uint16_t target = loopTargets[branch];
+    fprintf(f, "%04X,%04X,%llu,%llu\n", target, branch, (unsigned long long)loopTrips[branch], (unsigned long long)executions[target]);
+  }
+
+  delete[] loops;
+  return fclose(f) == 0;
+}
+
+void Heatmap::report(FILE* out) {
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < ADDRESS_SPACE; i++) total += executions[i];
+  if (total == 0) return;
+
+  fprintf(out, "window       executions\n");
+  for (uint32_t window = 0x8000; window < ADDRESS_SPACE; window += PRG_WINDOW_SIZE) {
+    uint64_t sum = 0;
+    for (uint32_t i = window; i < window + PRG_WINDOW_SIZE; i++) sum += executions[i];
+    fprintf(out, "$%04X  %12llu %6.2f%%\n", window, (unsigned long long)sum, 100.0 * sum / total);
+  }
+
+  uint16_t* loops = new uint16_t[ADDRESS_SPACE];
+  uint32_t count = rankLoops(loops);
+
+  fprintf(out, "\nloop   branch        trips\n");
+  for (uint32_t i = 0; i < count && i < REPORT_LOOPS; i++) {
+    fprintf(out, "$%04X  $%04X  %12llu\n", loopTargets[loops[i]], loops[i], (unsigned long long)loopTrips[loops[i]]);
+  }
+
+  delete[] loops;
+}
+
+#endif
+
+#if defined(CPU_PROFILE) || defined(CPU_HEATMAP)
+
+// Dump whatever was collected when the process exits
+struct ReportAtExit {
+  ~ReportAtExit() {
+#ifdef CPU_PROFILE
+    OpcodeProfile::report(stderr);
+#endif
+#ifdef CPU_HEATMAP
+    Heatmap::report(stderr);
+#endif
+  }
+};
+
+static ReportAtExit reportAtExit;
+
+#endif
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROFILE_PAGES 256
+#define PROFILE_MAX_CYCLES 16
+#define ADDRESS_SPACE 0x10000
+
+// Instrumentation policies for the CPU. The CPU calls the hooks of
+// CPUProfile on every instruction and memory access; NoProfile's hooks are
+// empty inlines, so a normal build carries no counters and no checks. Build
+// with CPU_PROFILE (make PROFILE=1) to select OpcodeProfile and/or
+// CPU_HEATMAP (make HEATMAP=1) to select Heatmap instead.
+struct NoProfile {
+  static inline void instruction(uint16_t pc, uint8_t opcode, uint8_t cycles, uint8_t pageCrossed, uint16_t nextPc) {}
+  static inline void read(uint16_t address) {}
+  static inline void write(uint16_t address) {}
+};
+
+// Runs two policies side by side
+template <class First, class Second>
+struct ProfilePair {
+  static inline void instruction(uint16_t pc, uint8_t opcode, uint8_t cycles, uint8_t pageCrossed, uint16_t nextPc) {
+    First::instruction(pc, opcode, cycles, pageCrossed, nextPc);
+    Second::instruction(pc, opcode, cycles, pageCrossed, nextPc);
+  }
+
+  static inline void read(uint16_t address) {
+    First::read(address);
+    Second::read(address);
+  }
+
+  static inline void write(uint16_t address) {
+    First::write(address);
+    Second::write(address);
+  }
+};
+
+// Per-opcode execution counts, cycles and page crossings that cost a cycle,
+// a histogram of instruction lengths in cycles, and reads and writes per 256
+// byte page.
+// The counters are process wide, so profile one console on one thread.
+struct OpcodeProfile {
+  static uint64_t executions[256];
+  static uint64_t cycles[256];
+  static uint64_t pageCrosses[256];
+  static uint64_t cycleHistogram[PROFILE_MAX_CYCLES];
+  static uint64_t reads[PROFILE_PAGES];
+  static uint64_t writes[PROFILE_PAGES];
+
+  static inline void instruction(uint16_t pc, uint8_t opcode, uint8_t taken, uint8_t pageCrossed, uint16_t nextPc) {
+    executions[opcode]++;
+    cycles[opcode] += taken;
+    pageCrosses[opcode] += crossed(opcode, taken);
+    cycleHistogram[taken < PROFILE_MAX_CYCLES ? taken : PROFILE_MAX_CYCLES - 1]++;
+  }
+
+  static inline void read(uint16_t address) {
+    reads[address >> 8]++;
+  }
+
+  static inline void write(uint16_t address) {
+    writes[address >> 8]++;
+  }
+
+  static void reset();
+
+  // Whether the instruction paid for a page cross: an indexed read that took
+  // more than its base cycles, or a taken branch that took two more. Stores
+  // and read-modify-writes set the addressing mode's flag but never pay.
+  static uint8_t crossed(uint8_t opcode, uint8_t taken);
+
+  // Opcodes sorted by total cycles, then the histogram and the busiest pages
+  static void report(FILE* out);
+};
+
+// Where the code is hot: executions per PC, reads and writes per address,
+// and backward branches and jumps (loops) with how often each was taken.
+// Executions are also summed per 8KB PRG window, which is the PRG bank for
+// the boards supported so far. Process wide, like OpcodeProfile.
+struct Heatmap {
+  static uint64_t executions[ADDRESS_SPACE];
+  static uint64_t reads[ADDRESS_SPACE];
+  static uint64_t writes[ADDRESS_SPACE];
+
+  // Indexed by the address of the branch or jump
+  static uint64_t loopTrips[ADDRESS_SPACE];
+  static uint16_t loopTargets[ADDRESS_SPACE];
+
+  static inline void instruction(uint16_t pc, uint8_t opcode, uint8_t cycles, uint8_t pageCrossed, uint16_t nextPc) {
+    executions[pc]++;
+
+    // Conditional branches are xxy10000; $4C is JMP absolute
+    if (nextPc <= pc && ((opcode & 0x1f) == 0x10 || opcode == 0x4c)) {
+      loopTrips[pc]++;
+      loopTargets[pc] = nextPc;
+    }
+  }
+
+  static inline void read(uint16_t address) {
+    reads[address]++;
+  }
+
+  static inline void write(uint16_t address) {
+    writes[address]++;
+  }
+
+  static void reset();
+
+  // "address,executions,reads,writes" for every address that was touched
+  static bool exportCSV(const char* path);
+
+  // A HeatmapHeader followed by the executions, reads and writes arrays
+  static bool exportBinary(const char* path);
+
+  // "target,branch,trips,executions", most taken first
+  static bool exportLoops(const char* path);
+
+  // PRG windows, then the hottest loops
+  static void report(FILE* out);
+};
+
+struct HeatmapHeader {
+  char magic[4]; // "TNHM"
+  uint32_t version;
+  uint32_t addresses;
+  uint32_t arrays;
+};
+
+#if defined(CPU_PROFILE) && defined(CPU_HEATMAP)
+typedef ProfilePair<OpcodeProfile, Heatmap> CPUProfile;
+#elif defined(CPU_PROFILE)
+typedef OpcodeProfile CPUProfile;
+#elif defined(CPU_HEATMAP)
+typedef Heatmap CPUProfile;
+#else
+typedef NoProfile CPUProfile;
+#endif
@@ -0,0 +1,202 @@
+#include <string.h>
+#include "Rewind.h"
+
+// A record is a series of runs, each a count of unchanged bytes followed by
+// a count of changed bytes and the changed bytes XORed with the base state.
+// A literal run only ends at four unchanged bytes in a row, so short gaps
+// don't cost a run header each.
+#define RUN_HEADER_SIZE 4
+#define MAX_RUN 0xffff
+#define MIN_ZERO_RUN 4
+
+Rewind::Rewind(Console* c, uint32_t size, uint32_t frameLimit, uint32_t interval)
+  : console(c), bufferSize(size), writeOffset(0), maxFrames(frameLimit), first(0), count(0),
+    keyframeInterval(interval ? interval : 1), sinceKeyframe(0),
+    previous(0), current(0), encoded(0), blank(0), stateSize(0) {
+  buffer = new uint8_t[bufferSize];
+  entries = new Entry[maxFrames];
+}
+
+Rewind::~Rewind() {
+  delete[] buffer;
+  delete[] entries;
+  delete[] previous;
+  delete[] current;
+  delete[] encoded;
+  delete[] blank;
+}
+
+void Rewind::reset() {
+  first = 0;
+  count = 0;
+  writeOffset = 0;
+  sinceKeyframe = 0;
+}
+
+uint32_t Rewind::frames() {
+  return count;
+}
+
+uint32_t Rewind::bytesUsed() {
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < count; i++) used += entry(i).size;
+  return used;
+}
+
+Rewind::Entry& Rewind::entry(uint32_t index) {
+  return entries[(first + index) % maxFrames];
+}
+
+// Deltas are useless without the keyframe they build on, so the rest of the
+// group goes with it
+void Rewind::dropOldest() {
+  do {
+    first = (first + 1) % maxFrames;
+    count--;
+  } while (count && !entry(0).keyframe);
+}
+
+// Make room for a record of the given size at writeOffset. Records never
+// straddle the end of the buffer; when one doesn't fit, the tail of the
+// oldest lap is dropped and writing continues from the start.
+void Rewind::allocate(uint32_t size) {
+  if (writeOffset + size > bufferSize) {
+    while (count && entry(0).offset >= writeOffset) dropOldest();
+    writeOffset = 0;
+  }
+
+  while (count && entry(0).offset < writeOffset + size && entry(0).offset + entry(0).size > writeOffset) {
+    dropOldest();
+  }
+
+  if (count == maxFrames) dropOldest();
+}
+
+void Rewind::capture() {
+  uint32_t size = (*console).stateSize();
+  if (size != stateSize) {
+    delete[] previous;
+    delete[] current;
+    delete[] encoded;
+    delete[] blank;
+    stateSize = size;
+    previous = new uint8_t[stateSize];
+    current = new uint8_t[stateSize];
+    encoded = new uint8_t[stateSize * 2 + RUN_HEADER_SIZE];
+    blank = new uint8_t[stateSize];
+    memset(blank, 0, stateSize);
+    reset();
+  }
+
+  (*console).saveState(current, stateSize);
+
+  bool keyframe = count == 0 || sinceKeyframe + 1 >= keyframeInterval;
+  uint32_t length = encode(current, keyframe ? blank : previous, encoded);
+  if (length > bufferSize) {
+    reset();
+    return;
+  }
+  allocate(length);
+
+  // Making room took the delta's keyframe with it
+  if (!keyframe && count == 0) {
+    keyframe = true;
+    length = encode(current, blank, encoded);
+    allocate(length);
+  }
+
+  memcpy(buffer + writeOffset, encoded, length);
+  entry(count) = { writeOffset, length, keyframe };
+  count++;
+  writeOffset += length;
+  sinceKeyframe = keyframe ? 0 : sinceKeyframe + 1;
+
+  uint8_t* swap = previous;
+  previous = current;
+  current = swap;
+}
+
+bool Rewind::rewind(uint32_t frames) {
+  if (frames >= count) return false;
+
+  uint32_t target = count - 1 - frames;
+  uint32_t key = target;
+  while (!entry(key).keyframe) key--;
+
+  memset(current, 0, stateSize);
+  for (uint32_t i = key; i <= target; i++) {
+    decode(buffer + entry(i).offset, entry(i).size, current);
+  }
+  if (!(*console).loadState(current, stateSize)) return false;
+
+  count = target + 1;
+  writeOffset = entry(target).offset + entry(target).size;
+  sinceKeyframe = target - key;
+
+  uint8_t* swap = previous;
+  previous = current;
+  current = swap;
+  return true;
+}
+
+static inline uint32_t load32(const uint8_t* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint64_t load64(const uint8_t* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint32_t Rewind::encode(const uint8_t* state, const uint8_t* base, uint8_t* out) {
+  uint8_t* start = out;
+  uint32_t i = 0;
+
+  while (i < stateSize) {
+    // Unchanged bytes, a word at a time while possible
+    uint32_t zeros = 0;
+    while (i + 8 <= stateSize && zeros + 8 <= MAX_RUN && load64(state + i) == load64(base + i)) {
+      i += 8;
+      zeros += 8;
+    }
+    while (i < stateSize && zeros < MAX_RUN && state[i] == base[i]) {
+      i++;
+      zeros++;
+    }
+
+    uint8_t* header = out;
+    out += RUN_HEADER_SIZE;
+
+    uint32_t literals = 0;
+    while (i < stateSize && literals < MAX_RUN) {
+      if (i + MIN_ZERO_RUN <= stateSize && load32(state + i) == load32(base + i)) break;
+      *out++ = state[i] ^ base[i];
+      i++;
+      literals++;
+    }
+
+    header[0] = zeros & 0xff;
+    header[1] = zeros >> 8;
+    header[2] = literals & 0xff;
+    header[3] = literals >> 8;
+  }
+
+  return out - start;
+}
+
+void Rewind::decode(const uint8_t* in, uint32_t size, uint8_t* state) {
+  const uint8_t* end = in + size;
+  uint32_t i = 0;
+
+  while (in < end) {
+    uint32_t zeros = in[0] | (in[1] << 8);
+    uint32_t literals = in[2] | (in[3] << 8);
+    in += RUN_HEADER_SIZE;
+
+    i += zeros;
+    for (uint32_t j = 0; j < literals; j++) state[i++] ^= *in++;
+  }
+}
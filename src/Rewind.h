@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+#define REWIND_KEYFRAME_INTERVAL 60
+
+// Frame-by-frame rewind history in a fixed-size ring buffer. Every
+// keyframeInterval frames a full savestate is stored; the frames in between
+// store the XOR of their state against the previous frame, run-length
+// encoded, which is mostly zeros. Restoring a frame decodes the nearest
+// keyframe before it and replays the deltas up to it. When the ring is full
+// the oldest frames are dropped, a whole keyframe group at a time.
+class Rewind {
+  public:
+    Rewind(Console* c, uint32_t bufferSize, uint32_t maxFrames, uint32_t keyframeInterval = REWIND_KEYFRAME_INTERVAL);
+    ~Rewind();
+
+    // Record the console's current state. Call once per frame.
+    void capture();
+
+    // Restore the state captured `frames` captures ago (0 is the latest) and
+    // drop everything newer. Returns false if that far back isn't available.
+    bool rewind(uint32_t frames);
+
+    void reset();
+
+    uint32_t frames();
+    uint32_t bytesUsed();
+
+  private:
+    struct Entry {
+      uint32_t offset;
+      uint32_t size;
+      uint8_t keyframe;
+    };
+
+    Console* console;
+
+    uint8_t* buffer;
+    uint32_t bufferSize;
+    uint32_t writeOffset;
+
+    Entry* entries;
+    uint32_t maxFrames;
+    uint32_t first;
+    uint32_t count;
+
+    uint32_t keyframeInterval;
+    uint32_t sinceKeyframe;
+
+    // The latest captured state, the state being captured, the encoder's
+    // output for it, and an all-zero base that keyframes are encoded against
+    uint8_t* previous;
+    uint8_t* current;
+    uint8_t* encoded;
+    uint8_t* blank;
+    uint32_t stateSize;
+
+    Entry& entry(uint32_t index);
+    void dropOldest();
+    void allocate(uint32_t size);
+
+    uint32_t encode(const uint8_t* state, const uint8_t* base, uint8_t* out);
+    void decode(const uint8_t* in, uint32_t size, uint8_t* state);
+};
@@ -0,0 +1,33 @@
+#include "RunAhead.h"
+
+RunAhead::RunAhead(Console* c, uint8_t n) : frames(n), console(c), state(0), stateSize(0) {}
+
+RunAhead::~RunAhead() {
+  delete[] state;
+}
+
+void RunAhead::runFrame() {
+  if (frames == 0) {
+    (*console).runFrame();
+    return;
+  }
+
+  uint32_t size = (*console).stateSize();
+  if (size != stateSize) {
+    delete[] state;
+    stateSize = size;
+    state = new uint8_t[stateSize];
+  }
+
+  (*console).ppu.skipRender = 1;
+  (*console).runFrame();
+  (*console).saveState(state, stateSize);
+
+  for (int i = 1; i < frames; i++) (*console).runFrame();
+
+  (*console).ppu.skipRender = 0;
+  (*console).runFrame();
+
+  // The framebuffer isn't part of the state, so the frame ahead stays
+  (*console).loadState(state, stateSize);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+// Run-ahead hides the game's own input lag. Each host frame advances the
+// real timeline by one hidden frame, saves state, runs `frames` frames
+// further with the same input, keeps the last of those in the framebuffer
+// and restores the saved state. The frames in between are run with
+// rendering skipped, so each extra frame costs little more than the CPU.
+class RunAhead {
+  public:
+    RunAhead(Console* c, uint8_t frames);
+    ~RunAhead();
+
+    // How many frames ahead to show. 0 runs frames normally.
+    uint8_t frames;
+
+    // Set the input with Console::setButtons first
+    void runFrame();
+
+  private:
+    Console* console;
+    uint8_t* state;
+    uint32_t stateSize;
+};
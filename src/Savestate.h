@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+// Savestate layout: a header followed by tagged sections, each a straight
+// copy of one component's state block. Values are stored in native byte
+// order (little endian on both the Teensy and x86 hosts). Bump the version
+// whenever the layout of any block changes.
+#define SAVESTATE_VERSION 4
+
+#define SECTION_ID(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+#define SECTION_CPU     SECTION_ID('C', 'P', 'U', ' ')
+#define SECTION_BUS     SECTION_ID('B', 'U', 'S', ' ')
+#define SECTION_PPU     SECTION_ID('P', 'P', 'U', ' ')
+#define SECTION_PRG_RAM SECTION_ID('P', 'R', 'A', 'M')
+#define SECTION_CHR_RAM SECTION_ID('C', 'R', 'A', 'M')
+#define SECTION_NT_RAM  SECTION_ID('N', 'R', 'A', 'M')
+#define SECTION_CART    SECTION_ID('C', 'A', 'R', 'T')
+
+#define MAX_STATE_BLOCKS 8
+
+struct SavestateHeader {
+  char magic[4]; // "TNSS"
+  uint16_t version;
+  uint16_t sectionCount;
+  uint32_t prgRomSize;
+  uint32_t chrSize;
+};
+
+struct SavestateSection {
+  uint32_t id;
+  uint32_t size;
+};
+
+// One contiguous block of component state
+struct StateBlock {
+  uint32_t id;
+  void* data;
+  uint32_t size;
+};
@@ -0,0 +1,100 @@
+#include "Scheduler.h"
+#include "Opcodes.h"
+#include "Footprint.h"
+
+#if __cplusplus >= 202002L && !defined(ARDUINO)
+
+Scheduler::Scheduler() : count(0) {}
+
+void Scheduler::add(Component* component) {
+  if (count < SCHEDULER_COMPONENTS) components[count++] = component;
+}
+
+HOT_CODE Component* Scheduler::next() {
+  Component* best = components[0];
+  for (int i = 1; i < count; i++) {
+    if ((*components[i]).time < (*best).time) best = components[i];
+  }
+  return best;
+}
+
+HOT_CODE void Scheduler::runUntil(Component* component, uint64_t time) {
+  while ((*component).time < time) (*component).handle.resume();
+}
+
+// The CPU goes first on a tie, so it always sees the PPU exactly at its own
+// cycle, as Console::step does between instructions
+CycleEngine::CycleEngine(Console* c) : console(c), accessTime(0) {
+  cpu.time = ppu.time = 0;
+  cpu.handle = runCPU().handle;
+  ppu.handle = runPPU().handle;
+  scheduler.add(&cpu);
+  scheduler.add(&ppu);
+
+  (*console).bus.syncAccess = syncAccess;
+  (*console).bus.syncContext = this;
+}
+
+CycleEngine::~CycleEngine() {
+  (*console).bus.syncAccess = 0;
+  (*console).bus.syncContext = 0;
+  cpu.handle.destroy();
+  ppu.handle.destroy();
+}
+
+HOT_CODE ComponentTask CycleEngine::runCPU() {
+  CPU6502& c = (*console).cpu;
+  Bus& bus = (*console).bus;
+  PPU& p = (*console).ppu;
+
+  while (true) {
+    if (p.nmiPending) {
+      p.nmiPending = 0;
+      c.nmi();
+      co_await cpu.advance(c.cycles);
+      continue;
+    }
+
+    // Instructions touch I/O registers on their last cycle. This is the base
+    // count, so an indexed access that crosses a page lands one cycle early.
+    uint8_t* page = bus.readPages[c.pc >> 8];
+    uint8_t cycles = page ? OPCODES[page[c.pc & 0xff]].cycles : 2;
+    accessTime = cpu.time + (cycles ? cycles - 1 : 0);
+
+    c.step();
+    uint32_t taken = c.cycles;
+    if (bus.stallCycles) {
+      taken += bus.stallCycles;
+      c.totalCycles += bus.stallCycles;
+      bus.stallCycles = 0;
+    }
+    co_await cpu.advance(taken);
+  }
+}
+
+HOT_CODE ComponentTask CycleEngine::runPPU() {
+  PPU& p = (*console).ppu;
+
+  while (true) {
+    p.tick(1);
+    co_await ppu.advance(1);
+  }
+}
+
+HOT_CODE void CycleEngine::syncAccess(void* self) {
+  CycleEngine& engine = *(CycleEngine*)self;
+  engine.scheduler.runUntil(&engine.ppu, engine.accessTime);
+}
+
+HOT_CODE void CycleEngine::runFrame() {
+  PPU& p = (*console).ppu;
+  p.frameComplete = 0;
+
+  while (true) {
+    Component* component = scheduler.next();
+    if (component == &cpu && p.frameComplete && !p.nmiPending) break;
+    (*component).handle.resume();
+  }
+}
+
+#endif
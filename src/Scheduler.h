@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include "Console.h"
+
+// Cycle-stepped alternative to Console::runFrame. Console steps the CPU a
+// whole instruction at a time and then runs the PPU for as many cycles as
+// it took, so a register access sees the PPU as it was when the instruction
+// started. Here the CPU and PPU are coroutines on one clock, resumed by a
+// single loop in time order with no threads. The PPU suspends after every
+// CPU cycle, and every access that goes through the bus first brings the
+// PPU up to the cycle that access happens on, the last of its instruction.
+//
+// There is no APU in the tree yet; it would be a third component.
+#if __cplusplus >= 202002L && !defined(ARDUINO)
+
+#include <coroutine>
+
+#define SCHEDULER_COMPONENTS 4
+
+// The body of a component: a coroutine that never returns and suspends by
+// co_awaiting Component::advance. It starts suspended.
+struct ComponentTask {
+  struct promise_type {
+    ComponentTask get_return_object() {
+      return { std::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+// A component has run everything before `time`, in CPU cycles
+struct Component {
+  std::coroutine_handle<> handle;
+  uint64_t time;
+
+  inline std::suspend_always advance(uint32_t cycles) {
+    time += cycles;
+    return {};
+  }
+};
+
+class Scheduler {
+  public:
+    Scheduler();
+
+    // Ties go to the component added first
+    void add(Component* component);
+
+    // The component furthest behind
+    Component* next();
+
+    // Run one component on its own until it reaches `time`
+    void runUntil(Component* component, uint64_t time);
+
+  private:
+    Component* components[SCHEDULER_COMPONENTS];
+    int count;
+};
+
+class CycleEngine {
+  public:
+    CycleEngine(Console* c);
+    ~CycleEngine();
+
+    // Like Console::runFrame, this stops at the first instruction boundary
+    // after the frame is complete, so the two can be used in turn and
+    // savestates work the same way
+    void runFrame();
+
+  private:
+    Console* console;
+    Scheduler scheduler;
+    Component cpu;
+    Component ppu;
+
+    // The cycle bus accesses of the current instruction happen on
+    uint64_t accessTime;
+
+    ComponentTask runCPU();
+    ComponentTask runPPU();
+    static void syncAccess(void* self);
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include "Trace.h"
+#include "Opcodes.h"
+#include "Footprint.h"
+
+static void formatOperand(const TraceRecord& r, AddressingMode mode, char* out, uint32_t size) {
+  uint8_t low = r.operands[0];
+  uint16_t word = r.operands[0] | (r.operands[1] << 8);
+
+  switch (mode) {
+    case Implicit: out[0] = '\0'; break;
+    case Accumulator: snprintf(out, size, "A"); break;
+    case Immediate: snprintf(out, size, "#$%02X", low); break;
+    case ZeroPage: snprintf(out, size, "$%02X", low); break;
+    case ZeroPageX: snprintf(out, size, "$%02X,X", low); break;
+    case ZeroPageY: snprintf(out, size, "$%02X,Y", low); break;
+    case Relative: snprintf(out, size, "$%04X", (uint16_t)(r.pc + 2 + (int8_t)low)); break;
+    case Absolute: snprintf(out, size, "$%04X", word); break;
+    case AbsoluteX: snprintf(out, size, "$%04X,X", word); break;
+    case AbsoluteY: snprintf(out, size, "$%04X,Y", word); break;
+    case Indirect: snprintf(out, size, "($%04X)", word); break;
+    case IndirectX: snprintf(out, size, "($%02X,X)", low); break;
+    case IndirectY: snprintf(out, size, "($%02X),Y", low); break;
+  }
+}
+
+COLD_CODE void formatTrace(const TraceRecord& r, char* out, uint32_t size) {
+  const OpcodeInfo& info = OPCODES[r.opcode];
+
+  char bytes[9];
+  if (info.length == 1) snprintf(bytes, sizeof(bytes), "%02X", r.opcode);
+  if (info.length == 2) snprintf(bytes, sizeof(bytes), "%02X %02X", r.opcode, r.operands[0]);
+  if (info.length == 3) snprintf(bytes, sizeof(bytes), "%02X %02X %02X", r.opcode, r.operands[0], r.operands[1]);
+
+  char operand[16];
+  char instruction[24];
+  formatOperand(r, info.mode, operand, sizeof(operand));
+  snprintf(instruction, sizeof(instruction), "%s %s", info.mnemonic, operand);
+
+  uint64_t cycle = 0;
+  memcpy(&cycle, r.cycle, sizeof(r.cycle));
+
+  snprintf(out, size, "%04X  %-8s %c%-32sA:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu",
+    r.pc, bytes, info.official ? ' ' : '*', instruction, r.a, r.x, r.y, r.p, r.sp, (unsigned long long)cycle);
+}
+
+#ifdef CPU_TRACE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+TraceRing::TraceRing() : header(0), records(0), mask(0), mappedSize(0) {}
+
+TraceRing::~TraceRing() {
+  close();
+}
+
+bool TraceRing::open(const char* path, uint32_t capacity) {
+  close();
+
+  uint32_t size = 1;
+  while (size < capacity && size < 0x80000000u) size <<= 1;
+
+  int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+
+  uint64_t bytes = sizeof(TraceHeader) + (uint64_t)size * sizeof(TraceRecord);
+  if (ftruncate(fd, bytes) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void* mapped = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) return false;
+
+  mappedSize = bytes;
+  header = (TraceHeader*)mapped;
+  records = (TraceRecord*)(header + 1);
+  mask = size - 1;
+
+  memcpy((*header).magic, "TNTR", 4);
+  (*header).version = TRACE_VERSION;
+  (*header).recordSize = sizeof(TraceRecord);
+  (*header).capacity = size;
+  (*header).head = 0;
+  return true;
+}
+
+void TraceRing::close() {
+  if (!header) return;
+  munmap(header, mappedSize);
+  header = 0;
+  records = 0;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Binary execution trace. With CPU_TRACE defined, every instruction the CPU
+// starts is written as one fixed-size record into a ring that lives in a
+// memory-mapped file, so a crash still leaves the last records on disk.
+// Without it none of this is compiled into the CPU. nes-trace decodes a
+// ring file into nestest.log format.
+#define TRACE_VERSION 1
+
+struct TraceRecord {
+  uint16_t pc;
+  uint8_t opcode;
+  uint8_t operands[2];
+  uint8_t a;
+  uint8_t x;
+  uint8_t y;
+  uint8_t p;
+  uint8_t sp;
+  uint8_t cycle[6]; // Low 48 bits of the cycle count before the instruction
+};
+
+static_assert(sizeof(TraceRecord) == 16, "trace records must stay 16 bytes");
+
+struct TraceHeader {
+  char magic[4]; // "TNTR"
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t capacity; // Records in the ring, a power of two
+  uint32_t reserved;
+  uint64_t head;     // Records written so far; the next goes at head % capacity
+};
+
+// Longest line formatTrace() produces, including the terminator
+#define TRACE_LINE_SIZE 96
+
+// Format a record the way nestest.log does, minus the memory annotations and
+// the PPU column, which a record doesn't carry
+void formatTrace(const TraceRecord& record, char* out, uint32_t size);
+
+#ifdef CPU_TRACE
+
+class TraceRing {
+  public:
+    TraceRing();
+    ~TraceRing();
+
+    // Create (or truncate) the ring file, rounding capacity up to a power
+    // of two. Returns false if the file can't be created or mapped.
+    bool open(const char* path, uint32_t capacity);
+    void close();
+
+    inline void write(const TraceRecord& record) {
+      memcpy(&records[(*header).head & mask], &record, sizeof(record));
+      (*header).head++;
+    }
+
+  private:
+    TraceHeader* header;
+    TraceRecord* records;
+    uint32_t mask;
+    uint64_t mappedSize;
+};
+
+#endif
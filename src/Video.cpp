@@ -0,0 +1,237 @@
+#include <string.h>
+#include "Video.h"
+#include "Footprint.h"
+
+#define COLOURS 64
+
+// 2C02 palette, 0xRRGGBB
+CONST_DATA static const uint32_t NES_RGB[COLOURS] = {
+  0x7c7c7c, 0x0000fc, 0x0000bc, 0x4428bc, 0x940084, 0xa80020, 0xa81000, 0x881400,
+  0x503000, 0x007800, 0x006800, 0x005800, 0x004058, 0x000000, 0x000000, 0x000000,
+  0xbcbcbc, 0x0078f8, 0x0058f8, 0x6844fc, 0xd800cc, 0xe40058, 0xf83800, 0xe45c10,
+  0xac7c00, 0x00b800, 0x00a800, 0x00a844, 0x008888, 0x000000, 0x000000, 0x000000,
+  0xf8f8f8, 0x3cbcfc, 0x6888fc, 0x9878f8, 0xf878f8, 0xf85898, 0xf87858, 0xfca044,
+  0xf8b800, 0xb8f818, 0x58d854, 0x58f898, 0x00e8d8, 0x787878, 0x000000, 0x000000,
+  0xfcfcfc, 0xa4e4fc, 0xb8b8f8, 0xd8b8f8, 0xf8b8f8, 0xf8a4c0, 0xf0d0b0, 0xfce0a8,
+  0xf8d878, 0xd8f878, 0xb8f8b8, 0xb8f8d8, 0x00fcfc, 0xf8d8f8, 0x000000, 0x000000
+};
+
+// Lookup tables, one entry per colour, built at compile time. Every entry
+// is 32 bits wide so lookups map onto 32-bit gathers.
+struct VideoTables {
+  uint32_t rgba[COLOURS];
+  uint32_t y[COLOURS];
+  uint32_t u[COLOURS];
+  uint32_t v[COLOURS];
+
+  constexpr VideoTables() : rgba(), y(), u(), v() {
+    for (int i = 0; i < COLOURS; i++) {
+      int r = NES_RGB[i] >> 16;
+      int g = (NES_RGB[i] >> 8) & 0xff;
+      int b = NES_RGB[i] & 0xff;
+      rgba[i] = r | (g << 8) | (b << 16) | 0xff000000u;
+      y[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+      u[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+      v[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+  }
+};
+
+static constexpr VideoTables TABLES;
+
+uint32_t videoFrameSize(uint8_t format) {
+  return format == VIDEO_RGBA ? VIDEO_RGBA_SIZE : VIDEO_YUV420_SIZE;
+}
+
+// The palette lookups become gathers on AVX2 and AVX-512
+VECTOR_CLONES
+void convertRGBA(const uint8_t* __restrict framebuffer, uint8_t* __restrict out) {
+  uint32_t* __restrict pixels = (uint32_t*)out;
+  for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+    pixels[i] = TABLES.rgba[framebuffer[i] & (COLOURS - 1)];
+  }
+}
+
+VECTOR_CLONES
+void convertYUV420(const uint8_t* __restrict framebuffer, uint8_t* __restrict out) {
+  uint8_t* __restrict yPlane = out;
+  uint8_t* __restrict uPlane = yPlane + SCREEN_WIDTH * SCREEN_HEIGHT;
+  uint8_t* __restrict vPlane = uPlane + SCREEN_WIDTH * SCREEN_HEIGHT / 4;
+
+  for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+    yPlane[i] = TABLES.y[framebuffer[i] & (COLOURS - 1)];
+  }
+
+  // Chroma is the rounded mean of each 2x2 block
+  for (int row = 0; row < SCREEN_HEIGHT / 2; row++) {
+    const uint8_t* top = framebuffer + row * 2 * SCREEN_WIDTH;
+    const uint8_t* bottom = top + SCREEN_WIDTH;
+    uint8_t* u = uPlane + row * SCREEN_WIDTH / 2;
+    uint8_t* v = vPlane + row * SCREEN_WIDTH / 2;
+
+    for (int x = 0; x < SCREEN_WIDTH / 2; x++) {
+      int a = top[x * 2] & (COLOURS - 1), b = top[x * 2 + 1] & (COLOURS - 1);
+      int c = bottom[x * 2] & (COLOURS - 1), d = bottom[x * 2 + 1] & (COLOURS - 1);
+      u[x] = (TABLES.u[a] + TABLES.u[b] + TABLES.u[c] + TABLES.u[d] + 2) >> 2;
+      v[x] = (TABLES.v[a] + TABLES.v[b] + TABLES.v[c] + TABLES.v[d] + 2) >> 2;
+    }
+  }
+}
+
+void convertFrame(const uint8_t* framebuffer, uint8_t format, uint8_t* out) {
+  if (format == VIDEO_RGBA) {
+    convertRGBA(framebuffer, out);
+  } else {
+    convertYUV420(framebuffer, out);
+  }
+}
+
+#ifndef ARDUINO
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define Y4M_FRAME_HEADER "FRAME\n"
+
+VideoWriter::VideoWriter() : fd(-1), format(VIDEO_RGBA), y4m(false), frameSize(0), current(0),
+    running(false), stopping(false), failed(false), written(0) {
+  buffers[0] = buffers[1] = 0;
+  full[0] = full[1] = false;
+  pthread_mutex_init(&lock, 0);
+  pthread_cond_init(&changed, 0);
+}
+
+VideoWriter::~VideoWriter() {
+  close();
+  pthread_mutex_destroy(&lock);
+  pthread_cond_destroy(&changed);
+}
+
+bool VideoWriter::open(const char* path, uint8_t f, bool container) {
+  close();
+  if (container && f != VIDEO_YUV420) return false;
+
+  fd = strcmp(path, "-") == 0 ? STDOUT_FILENO : ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+
+  format = f;
+  y4m = container;
+  frameSize = videoFrameSize(format);
+  buffers[0] = new uint8_t[frameSize];
+  buffers[1] = new uint8_t[frameSize];
+  full[0] = full[1] = false;
+  current = 0;
+  stopping = false;
+  failed = false;
+  written = 0;
+
+  if (y4m) {
+    char header[128];
+    int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:%d Ip A8:7 C420jpeg\n",
+      SCREEN_WIDTH, SCREEN_HEIGHT, FRAME_RATE_NUM, FRAME_RATE_DEN);
+    if (!writeAll((const uint8_t*)header, length)) {
+      close();
+      return false;
+    }
+  }
+
+  running = pthread_create(&thread, 0, run, this) == 0;
+  if (!running) close();
+  return running;
+}
+
+// Waits for the queued frames to be written
+bool VideoWriter::close() {
+  if (running) {
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, 0);
+    running = false;
+  }
+
+  bool ok = !failed;
+  if (fd >= 0 && fd != STDOUT_FILENO && ::close(fd) != 0) ok = false;
+  fd = -1;
+
+  delete[] buffers[0];
+  delete[] buffers[1];
+  buffers[0] = buffers[1] = 0;
+  return ok;
+}
+
+uint8_t* VideoWriter::frame() {
+  return buffers[current];
+}
+
+bool VideoWriter::submit() {
+  pthread_mutex_lock(&lock);
+  full[current] = true;
+  pthread_cond_broadcast(&changed);
+
+  // The other buffer is free unless the writer is still on it
+  current ^= 1;
+  while (full[current] && !failed) pthread_cond_wait(&changed, &lock);
+  bool ok = !failed;
+  pthread_mutex_unlock(&lock);
+  return ok;
+}
+
+bool VideoWriter::capture(const uint8_t* framebuffer) {
+  convertFrame(framebuffer, format, frame());
+  return submit();
+}
+
+uint64_t VideoWriter::framesWritten() {
+  pthread_mutex_lock(&lock);
+  uint64_t frames = written;
+  pthread_mutex_unlock(&lock);
+  return frames;
+}
+
+void* VideoWriter::run(void* self) {
+  (*(VideoWriter*)self).writeLoop();
+  return 0;
+}
+
+// Buffers are written in the order they were submitted, which alternates
+void VideoWriter::writeLoop() {
+  int next = 0;
+  pthread_mutex_lock(&lock);
+  while (true) {
+    while (!full[next] && !stopping) pthread_cond_wait(&changed, &lock);
+    if (!full[next]) break;
+    pthread_mutex_unlock(&lock);
+
+    bool ok = (!y4m || writeAll((const uint8_t*)Y4M_FRAME_HEADER, sizeof(Y4M_FRAME_HEADER) - 1)) &&
+      writeAll(buffers[next], frameSize);
+
+    pthread_mutex_lock(&lock);
+    full[next] = false;
+    if (ok) {
+      written++;
+    } else {
+      failed = true;
+    }
+    pthread_cond_broadcast(&changed);
+    if (failed) break;
+    next ^= 1;
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+bool VideoWriter::writeAll(const uint8_t* data, uint32_t size) {
+  while (size) {
+    ssize_t count = ::write(fd, data, size);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    data += count;
+    size -= count;
+  }
+  return true;
+}
+
+#endif
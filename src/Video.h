@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include "PPU.h"
+
+// Colour conversion of the PPU's indexed framebuffer, and (on hosts) a video
+// stream writer for piping frames into an external encoder.
+#define VIDEO_RGBA 0   // 4 bytes per pixel, R G B A
+#define VIDEO_YUV420 1 // Planar Y, then U and V at half resolution (BT.601, limited range)
+
+#define VIDEO_RGBA_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT * 4)
+#define VIDEO_YUV420_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT * 3 / 2)
+
+uint32_t videoFrameSize(uint8_t format);
+
+// Convert one whole framebuffer. Both are table lookups per pixel (and per
+// 2x2 block for chroma), written so they vectorise.
+void convertRGBA(const uint8_t* framebuffer, uint8_t* out);
+void convertYUV420(const uint8_t* framebuffer, uint8_t* out);
+void convertFrame(const uint8_t* framebuffer, uint8_t format, uint8_t* out);
+
+#ifndef ARDUINO
+
+#include <pthread.h>
+
+// Double-buffered frame writer. The caller converts straight into frame(),
+// then submit() hands that buffer to a writer thread and returns the other
+// one, so frames are never copied and the emulator only waits when the
+// output falls a whole frame behind. With y4m set the stream is YUV4MPEG2
+// (YUV420 only); otherwise it is raw frames back to back.
+class VideoWriter {
+  public:
+    VideoWriter();
+    ~VideoWriter();
+
+    // "-" writes to stdout. Returns false if the file can't be opened or
+    // the format doesn't fit the container.
+    bool open(const char* path, uint8_t format, bool y4m);
+    bool close();
+
+    uint8_t* frame();
+    bool submit();
+
+    // Convert a framebuffer into frame() and submit it
+    bool capture(const uint8_t* framebuffer);
+
+    uint64_t framesWritten();
+
+  private:
+    int fd;
+    uint8_t format;
+    bool y4m;
+    uint32_t frameSize;
+
+    uint8_t* buffers[2];
+    bool full[2];
+    int current;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool running;
+    bool stopping;
+    bool failed;
+    uint64_t written;
+
+    static void* run(void* self);
+    void writeLoop();
+    bool writeAll(const uint8_t* data, uint32_t size);
+};
+
+#endif
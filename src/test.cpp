@@ -1,15 +1,1304 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <vector>
 
-#include "CPU.h"
-#include "Bus.h"
+#include "Console.h"
+#include "Opcodes.h"
+#include "Rewind.h"
+#include "RunAhead.h"
+#include "Movie.h"
+#include "FrameHash.h"
+#include "Video.h"
+#include "FastForward.h"
+#include "Lockstep.h"
+#include "BatterySave.h"
+#include "Env.h"
+#include "Scheduler.h"
+#include "Latency.h"
+#include "Debugger.h"
+#include "Profile.h"
+#include "Trace.h"
+#include "../tools/common.h"
+
+#define TEST_ORIGIN 0x0200
+
+// Control flow instructions don't advance the PC by their length
+static bool isControlFlow(const char* mnemonic) {
+  const char* names[] = { "BRK", "JAM", "JMP", "JSR", "RTI", "RTS" };
+  for (const char* name : names) {
+    if (strcmp(mnemonic, name) == 0) return true;
+  }
+  return false;
+}
+
+// Branches are encoded as xxy10000: xx selects N/V/C/Z, y is the value tested
+static bool branchTaken(uint8_t opcode, uint8_t p) {
+  const uint8_t flags[] = { NEGATIVE_BIT, OVERFLOW_BIT, CARRY_BIT, ZERO_BIT };
+  return BIT_VALUE(p, flags[opcode >> 6]) == BIT_VALUE(opcode, 5);
+}
+
+// Execute every opcode once from a known state and check the operand length
+// and cycle count against the reference table, with and without an index
+// register pushing the effective address over a page boundary.
+static int testOpcodeTable(Console& console) {
+  Bus& b = console.bus;
+  CPU6502& cpu = console.cpu;
+  int failures = 0;
+
+  for (int opcode = 0; opcode < 256; opcode++) {
+    const OpcodeInfo& info = OPCODES[opcode];
+
+    for (int crossPage = 0; crossPage < 2; crossPage++) {
+      memset(b.ram, 0, sizeof(b.ram));
+      b.ram[TEST_ORIGIN] = opcode;
+      b.ram[TEST_ORIGIN + 1] = 0x10;
+      b.ram[0x10] = 0x01;
+
+      cpu.a = 0;
+      cpu.x = cpu.y = crossPage ? 0xff : 0;
+      cpu.sp = 0xfd;
+      cpu.p = 0x24;
+      cpu.pc = TEST_ORIGIN;
+      console.step();
+
+      uint8_t expectedCycles = info.cycles;
+      uint16_t expectedPc = TEST_ORIGIN + info.length;
+
+      bool indexed = info.mode == AbsoluteX || info.mode == AbsoluteY || info.mode == IndirectY;
+      if (crossPage && indexed && info.pageCross) expectedCycles++;
+
+      if (info.mode == Relative && branchTaken(opcode, 0x24)) {
+        expectedCycles++;
+        expectedPc += 0x10;
+      }
+
+      if (cpu.cycles != expectedCycles) {
+        printf("%02X %s: %d cycles, expected %d\n", opcode, info.mnemonic, cpu.cycles, expectedCycles);
+        failures++;
+      }
+
+      if (!isControlFlow(info.mnemonic) && cpu.pc != expectedPc) {
+        printf("%02X %s: pc=%04X, expected %04X\n", opcode, info.mnemonic, cpu.pc, expectedPc);
+        failures++;
+      }
+    }
+  }
+
+  return failures;
+}
+
+// Short programs with known results, covering the flag and addressing
+// behaviour that nestest and the functional test check first
+struct InstructionCase {
+  const char* name;
+  uint8_t program[4];
+  int steps;
+  uint8_t a, x, y, p;
+  uint16_t pokeAddress;
+  uint8_t pokeValue;
+  uint8_t expectedA, expectedP;
+  uint16_t expectedPc; // 0 to skip
+  uint8_t expectedMemory; // Value at $10 afterwards
+};
+
+static const InstructionCase INSTRUCTION_CASES[] = {
+  { "ADC overflow",     { 0x69, 0x50 },             1, 0x50, 0, 0, 0x24, 0, 0, 0xa0, 0xe4, 0, 0x00 },
+  { "ADC carry",        { 0x69, 0x01 },             1, 0xff, 0, 0, 0x24, 0, 0, 0x00, 0x27, 0, 0x00 },
+  { "SBC borrow",       { 0xe9, 0x01 },             1, 0x00, 0, 0, 0x25, 0, 0, 0xff, 0xa4, 0, 0x00 },
+  { "SBC overflow",     { 0xe9, 0x01 },             1, 0x80, 0, 0, 0x25, 0, 0, 0x7f, 0x65, 0, 0x00 },
+  { "CMP greater",      { 0xc9, 0x10 },             1, 0x20, 0, 0, 0x24, 0, 0, 0x20, 0x25, 0, 0x00 },
+  { "CMP less",         { 0xc9, 0x20 },             1, 0x10, 0, 0, 0x24, 0, 0, 0x10, 0xa4, 0, 0x00 },
+  { "CPX equal",        { 0xe0, 0x05 },             1, 0x00, 5, 0, 0x24, 0, 0, 0x00, 0x27, 0, 0x00 },
+  { "ASL keeps V",      { 0x0a },                   1, 0x81, 0, 0, 0x64, 0, 0, 0x02, 0x65, 0, 0x00 },
+  { "BIT from memory",  { 0x24, 0x10 },             1, 0x00, 0, 0, 0x24, 0x10, 0xc0, 0x00, 0xe6, 0, 0xc0 },
+  { "STY",              { 0x84, 0x10 },             1, 0x00, 0, 0x42, 0x26, 0, 0, 0x00, 0x26, 0, 0x42 },
+  { "PHP sets B",       { 0x08, 0x68 },             2, 0x00, 0, 0, 0x24, 0, 0, 0x34, 0x24, 0, 0x00 },
+  { "PLP clears B",     { 0xa9, 0xff, 0x48, 0x28 }, 3, 0x00, 0, 0, 0x24, 0, 0, 0xff, 0xef, 0, 0x00 },
+  { "JMP page wrap",    { 0x6c, 0xff, 0x02 },       1, 0x00, 0, 0, 0x24, 0x02ff, 0x34, 0x00, 0x24, 0x6c34, 0x00 },
+};
+
+static int testInstructions(Console& console) {
+  Bus& b = console.bus;
+  CPU6502& cpu = console.cpu;
+  int failures = 0;
+
+  for (const InstructionCase& c : INSTRUCTION_CASES) {
+    memset(b.ram, 0, sizeof(b.ram));
+    memcpy(&b.ram[TEST_ORIGIN], c.program, sizeof(c.program));
+    if (c.pokeAddress) b.ram[c.pokeAddress] = c.pokeValue;
+
+    cpu.a = c.a;
+    cpu.x = c.x;
+    cpu.y = c.y;
+    cpu.p = c.p;
+    cpu.sp = 0xfd;
+    cpu.pc = TEST_ORIGIN;
+    for (int i = 0; i < c.steps; i++) console.step();
+
+    if (cpu.a != c.expectedA || cpu.p != c.expectedP || b.ram[0x10] != c.expectedMemory || (c.expectedPc && cpu.pc != c.expectedPc)) {
+      printf("%s: A=%02X P=%02X PC=%04X [$10]=%02X, expected A=%02X P=%02X [$10]=%02X\n",
+        c.name, cpu.a, cpu.p, cpu.pc, b.ram[0x10], c.expectedA, c.expectedP, c.expectedMemory);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+// A 16KB NROM image whose main loop scribbles over RAM and VRAM while the
+// NMI handler scrolls the screen, so every frame changes the machine state
+static std::vector<uint8_t> buildTestROM() {
+  const uint8_t program[] = {
+    0x78,             // $C000 SEI
+    0xa2, 0xff,       //       LDX #$FF
+    0x9a,             //       TXS
+    0xa9, 0x80,       //       LDA #$80
+    0x8d, 0x00, 0x20, //       STA $2000
+    0xa9, 0x1e,       //       LDA #$1E
+    0x8d, 0x01, 0x20, //       STA $2001
+    0xe6, 0x20,       // $C00E INC $20
+    0xa5, 0x20,       //       LDA $20
+    0x8d, 0x07, 0x20, //       STA $2007
+    0x4c, 0x0e, 0xc0, //       JMP $C00E
+    0xe6, 0x10,       // $C018 INC $10
+    0xa5, 0x10,       //       LDA $10
+    0x8d, 0x05, 0x20, //       STA $2005
+    0x8d, 0x05, 0x20, //       STA $2005
+    0xa9, 0x01,       //       LDA #$01
+    0x8d, 0x16, 0x40, //       STA $4016
+    0xa9, 0x00,       //       LDA #$00
+    0x8d, 0x16, 0x40, //       STA $4016
+    0xa2, 0x08,       //       LDX #$08
+    0xad, 0x16, 0x40, // $C02E LDA $4016
+    0x4a,             //       LSR A
+    0x26, 0x11,       //       ROL $11
+    0xca,             //       DEX
+    0xd0, 0xf7,       //       BNE $C02E
+    0x40              //       RTI
+  };
+
+  return buildROM(program, sizeof(program), 0xc000, 0xc018);
+}
+
+// Pad reads shown as the backdrop colour: the NMI handler reads port 1 into
+// $11, bit reversed, and writes that to palette entry 0
+static std::vector<uint8_t> buildLatencyROM() {
+  const uint8_t program[] = {
+    0x78,             // $C000 SEI
+    0xa2, 0xff,       //       LDX #$FF
+    0x9a,             //       TXS
+    0xa9, 0x80,       //       LDA #$80
+    0x8d, 0x00, 0x20, //       STA $2000
+    0xa9, 0x1e,       //       LDA #$1E
+    0x8d, 0x01, 0x20, //       STA $2001
+    0x4c, 0x0e, 0xc0, // $C00E JMP $C00E
+    0xa9, 0x01,       // $C011 LDA #$01
+    0x8d, 0x16, 0x40, //       STA $4016
+    0xa9, 0x00,       //       LDA #$00
+    0x8d, 0x16, 0x40, //       STA $4016
+    0xa2, 0x08,       //       LDX #$08
+    0xad, 0x16, 0x40, // $C01D LDA $4016
+    0x4a,             //       LSR A
+    0x26, 0x11,       //       ROL $11
+    0xca,             //       DEX
+    0xd0, 0xf7,       //       BNE $C01D
+    0xa9, 0x3f,       //       LDA #$3F
+    0x8d, 0x06, 0x20, //       STA $2006
+    0xa9, 0x00,       //       LDA #$00
+    0x8d, 0x06, 0x20, //       STA $2006
+    0xa5, 0x11,       //       LDA $11
+    0x8d, 0x07, 0x20, //       STA $2007
+    0xa9, 0x00,       //       LDA #$00
+    0x8d, 0x06, 0x20, //       STA $2006
+    0x8d, 0x06, 0x20, //       STA $2006
+    0x40              //       RTI
+  };
+
+  return buildROM(program, sizeof(program), 0xc000, 0xc011);
+}
+
+// Save, run on, restore and run on again; both runs must end up identical
+static int testSavestate(Console& console) {
+  std::vector<uint8_t> rom = buildTestROM();
+  if (!console.loadROM(rom.data(), rom.size())) {
+    printf("savestate: test ROM failed to load\n");
+    return 1;
+  }
+
+  for (int i = 0; i < 10; i++) console.runFrame();
+
+  std::vector<uint8_t> state(console.stateSize());
+  if (console.saveState(state.data(), state.size()) != state.size()) {
+    printf("savestate: save failed\n");
+    return 1;
+  }
+
+  for (int i = 0; i < 5; i++) console.runFrame();
+  CPURegisters cpu = console.cpu;
+  std::vector<uint8_t> ram(console.bus.ram, console.bus.ram + RAM_SIZE);
+  std::vector<uint8_t> frame(console.ppu.framebuffer, console.ppu.framebuffer + FRAMEBUFFER_SIZE);
+
+  int failures = 0;
+  if (!console.loadState(state.data(), state.size())) {
+    printf("savestate: load failed\n");
+    return 1;
+  }
+  for (int i = 0; i < 5; i++) console.runFrame();
+
+  if (memcmp(&cpu, static_cast<CPURegisters*>(&console.cpu), sizeof(cpu)) != 0) {
+    printf("savestate: CPU registers differ after restore\n");
+    failures++;
+  }
+  if (memcmp(ram.data(), console.bus.ram, RAM_SIZE) != 0) {
+    printf("savestate: RAM differs after restore\n");
+    failures++;
+  }
+  if (memcmp(frame.data(), console.ppu.framebuffer, frame.size()) != 0) {
+    printf("savestate: framebuffer differs after restore\n");
+    failures++;
+  }
+
+  // A state from another version must be rejected
+  state[4]++;
+  if (console.loadState(state.data(), state.size())) {
+    printf("savestate: accepted a state with the wrong version\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// Capture a run into a ring small enough to wrap, then rewind to frames in
+// the middle of keyframe groups and compare against full savestates
+static int testRewind(Console& console) {
+  std::vector<uint8_t> rom = buildTestROM();
+  console.loadROM(rom.data(), rom.size());
+
+  const int frameCount = 300;
+  Rewind rewind(&console, 48 * 1024, 128, 16);
+  std::vector<std::vector<uint8_t> > states;
+
+  for (int i = 0; i < frameCount; i++) {
+    console.runFrame();
+    rewind.capture();
+    states.push_back(std::vector<uint8_t>(console.stateSize()));
+    console.saveState(states.back().data(), states.back().size());
+  }
+
+  int failures = 0;
+  if (rewind.frames() == 0 || rewind.frames() >= frameCount || rewind.bytesUsed() > 48 * 1024) {
+    printf("rewind: ring holds %u frames in %u bytes\n", rewind.frames(), rewind.bytesUsed());
+    failures++;
+  }
+
+  std::vector<uint8_t> state(console.stateSize());
+  int latest = frameCount - 1;
+  const uint32_t steps[] = { 0, 5, 17, 3 };
+  for (uint32_t back : steps) {
+    if (!rewind.rewind(back)) {
+      printf("rewind: couldn't go back %u frames\n", back);
+      failures++;
+      continue;
+    }
+    latest -= back;
+    console.saveState(state.data(), state.size());
+    if (state != states[latest]) {
+      printf("rewind: state %d differs after rewinding %u frames\n", latest, back);
+      failures++;
+    }
+  }
+
+  if (rewind.rewind(rewind.frames())) {
+    printf("rewind: went back further than the ring holds\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// Run-ahead must leave the real timeline exactly where plain emulation is,
+// while showing the frame that plain emulation reaches `frames` later
+static int testRunAhead(Console& console) {
+  std::vector<uint8_t> rom = buildTestROM();
+  Console ahead;
+  console.loadROM(rom.data(), rom.size());
+  ahead.loadROM(rom.data(), rom.size());
+
+  const int lookahead = 2;
+  RunAhead runAhead(&ahead, lookahead);
+  std::vector<uint8_t> expected(console.stateSize());
+  std::vector<uint8_t> actual(ahead.stateSize());
+  int failures = 0;
+
+  for (int i = 0; i < 20; i++) {
+    runAhead.runFrame();
+
+    console.runFrame();
+    console.saveState(expected.data(), expected.size());
+    ahead.saveState(actual.data(), actual.size());
+    if (expected != actual) {
+      printf("runahead: frame %d state differs from plain emulation\n", i);
+      failures++;
+    }
+
+    for (int j = 0; j < lookahead; j++) console.runFrame();
+    if (memcmp(console.ppu.framebuffer, ahead.ppu.framebuffer, FRAMEBUFFER_SIZE) != 0) {
+      printf("runahead: frame %d shows the wrong picture\n", i);
+      failures++;
+    }
+    console.loadState(expected.data(), expected.size());
+  }
+
+  return failures;
+}
+
+// Record input into a movie while the test ROM reads the pad every NMI,
+// then replay the saved movie on a fresh console and compare the result
+static int testMovie(Console& console) {
+  int failures = 0;
+
+  Controller pad;
+  pad.reset();
+  pad.buttons = BUTTON_A | BUTTON_START | BUTTON_RIGHT;
+  pad.write(1);
+  pad.write(0);
+  const uint8_t bits[] = { 1, 0, 0, 1, 0, 0, 0, 1, 1, 1 };
+  for (uint8_t bit : bits) {
+    if (pad.read() != bit) {
+      printf("movie: controller shifted out the wrong bits\n");
+      failures++;
+      break;
+    }
+  }
+
+  std::vector<uint8_t> rom = buildTestROM();
+  console.loadROM(rom.data(), rom.size());
+
+  Movie movie;
+  for (int i = 0; i < 120; i++) {
+    uint8_t buttons = (i / 10) * 37;
+    console.setButtons(0, buttons);
+    movie.record(console);
+    console.runFrame();
+
+    // The NMI handler reads port 1 into $11, MSB first
+    uint8_t read = console.bus.ram[0x11];
+    uint8_t reversed = 0;
+    for (int bit = 0; bit < 8; bit++) reversed |= ((buttons >> bit) & 0x01) << (7 - bit);
+    if (read != reversed) {
+      printf("movie: frame %d read %02x from the pad, expected %02x\n", i, read, reversed);
+      failures++;
+      break;
+    }
+  }
+
+  std::vector<uint8_t> expected(console.stateSize());
+  console.saveState(expected.data(), expected.size());
+
+  std::vector<uint8_t> file(movie.size());
+  Movie replay;
+  if (movie.save(file.data(), file.size()) != file.size() || !replay.load(file.data(), file.size())) {
+    printf("movie: save/load failed\n");
+    return failures + 1;
+  }
+  if (replay.frames() != 120 || file.size() > sizeof(MovieHeader) + 12 * 3) {
+    printf("movie: %u frames in %zu bytes\n", replay.frames(), file.size());
+    failures++;
+  }
+
+  console.loadROM(rom.data(), rom.size());
+  for (uint32_t i = 0; i < replay.frames(); i++) {
+    replay.play(console);
+    console.runFrame();
+  }
+
+  std::vector<uint8_t> actual(console.stateSize());
+  console.saveState(actual.data(), actual.size());
+  if (expected != actual) {
+    printf("movie: replay ended in a different state\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+static int testFrameHash(Console& console) {
+  int failures = 0;
+
+  // Every size up to a few stripes, so tails and block edges are covered;
+  // flipping any one bit has to change the hash
+  std::vector<uint8_t> data(300);
+  for (size_t i = 0; i < data.size(); i++) data[i] = i * 13;
+  for (uint32_t size = 1; size <= data.size() && !failures; size++) {
+    uint64_t hash = hash64(data.data(), size, 0);
+    if (hash == hash64(data.data(), size - 1, 0) || hash == hash64(data.data(), size, 1)) {
+      printf("framehash: size %u collides with its neighbours\n", size);
+      failures++;
+    }
+    for (uint32_t bit = 0; bit < size * 8 && !failures; bit += 7) {
+      data[bit / 8] ^= 1 << (bit % 8);
+      if (hash64(data.data(), size, 0) == hash) {
+        printf("framehash: flipping bit %u of %u bytes kept the hash\n", bit, size);
+        failures++;
+      }
+      data[bit / 8] ^= 1 << (bit % 8);
+    }
+  }
+
+  std::vector<uint8_t> rom = buildTestROM();
+  console.loadROM(rom.data(), rom.size());
+
+  HashLog log;
+  log.flags = HASHLOG_RAM;
+  for (int i = 0; i < 60; i++) {
+    console.runFrame();
+    log.record(console);
+  }
+
+  std::vector<uint8_t> file(log.size());
+  HashLog golden;
+  if (log.save(file.data(), file.size()) != file.size() || !golden.load(file.data(), file.size())) {
+    printf("framehash: save/load failed\n");
+    return failures + 1;
+  }
+
+  // Same run again, then one with a frame disturbed
+  console.loadROM(rom.data(), rom.size());
+  HashLog again, disturbed;
+  again.flags = disturbed.flags = HASHLOG_RAM;
+  for (int i = 0; i < 60; i++) {
+    console.runFrame();
+    again.record(console);
+    disturbed.record(console);
+    if (i == 41) disturbed.record(console);
+  }
+
+  if (again.compare(golden) != HASHLOG_MATCH) {
+    printf("framehash: identical run differs at frame %u\n", again.compare(golden));
+    failures++;
+  }
+  if (disturbed.compare(golden) != 42) {
+    printf("framehash: disturbed run differs at frame %u, expected 42\n", disturbed.compare(golden));
+    failures++;
+  }
+
+  return failures;
+}
+
+static int testVideo(Console& console) {
+  int failures = 0;
+
+  // Colour $0F is black and $30 white, so the planes have known values;
+  // the top-left 2x2 block mixes them
+  static uint8_t framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+  memset(framebuffer, 0x0f, sizeof(framebuffer));
+  framebuffer[0] = framebuffer[SCREEN_WIDTH + 1] = 0x30 | 0xc0;
+
+  std::vector<uint8_t> rgba(VIDEO_RGBA_SIZE), yuv(VIDEO_YUV420_SIZE);
+  convertRGBA(framebuffer, rgba.data());
+  convertYUV420(framebuffer, yuv.data());
+
+  const uint8_t white[] = { 0xfc, 0xfc, 0xfc, 0xff }, black[] = { 0, 0, 0, 0xff };
+  if (memcmp(&rgba[0], white, 4) != 0 || memcmp(&rgba[4], black, 4) != 0 || memcmp(&rgba[VIDEO_RGBA_SIZE - 4], black, 4) != 0) {
+    printf("video: wrong RGBA pixels\n");
+    failures++;
+  }
+
+  uint8_t* u = &yuv[SCREEN_WIDTH * SCREEN_HEIGHT];
+  uint8_t* v = u + SCREEN_WIDTH * SCREEN_HEIGHT / 4;
+  if (yuv[0] != 233 || yuv[1] != 16 || u[0] != 128 || v[0] != 128 || u[1] != 128) {
+    printf("video: wrong YUV420 samples (Y %u %u, U %u, V %u)\n", yuv[0], yuv[1], u[0], v[0]);
+    failures++;
+  }
+
+  // A short Y4M stream: header, then each frame behind "FRAME\n"
+  std::vector<uint8_t> rom = buildTestROM();
+  console.loadROM(rom.data(), rom.size());
+
+  const char* path = "bin/test.y4m";
+  VideoWriter writer;
+  if (!writer.open(path, VIDEO_YUV420, true)) {
+    printf("video: cannot open %s\n", path);
+    return failures + 1;
+  }
+  for (int i = 0; i < 5; i++) {
+    console.runFrame();
+    if (!writer.capture(console.ppu.framebuffer)) failures++;
+  }
+  if (!writer.close() || writer.framesWritten() != 5) {
+    printf("video: writer wrote %llu of 5 frames\n", (unsigned long long)writer.framesWritten());
+    failures++;
+  }
+
+  FILE* f = fopen(path, "rb");
+  std::vector<uint8_t> stream(1 << 20);
+  size_t size = f ? fread(stream.data(), 1, stream.size(), f) : 0;
+  if (f) fclose(f);
+  remove(path);
+
+  const char* header = (const char*)stream.data();
+  size_t headerSize = (const uint8_t*)memchr(header, '\n', size) - stream.data() + 1;
+  size_t frameSize = 6 + VIDEO_YUV420_SIZE;
+  convertYUV420(console.ppu.framebuffer, yuv.data());
+  if (strncmp(header, "YUV4MPEG2 W256 H240 ", 20) != 0 || size != headerSize + 5 * frameSize ||
+      memcmp(&stream[headerSize + 4 * frameSize], "FRAME\n", 6) != 0 ||
+      memcmp(&stream[headerSize + 4 * frameSize + 6], yuv.data(), yuv.size()) != 0) {
+    printf("video: bad Y4M stream (%zu bytes)\n", size);
+    failures++;
+  }
+
+  return failures;
+}
+
+// Fast-forward has to run exactly the same frames as plain emulation, with
+// the presented ones rendered in full. The test ROM's sprite 0 sits on
+// drawn background, so this covers sprite 0 hits in skipped frames.
+static int testFastForward(Console& console) {
+  std::vector<uint8_t> rom = buildTestROM();
+  Console turbo;
+  console.loadROM(rom.data(), rom.size());
+  turbo.loadROM(rom.data(), rom.size());
+
+  FastForward fastForward(&turbo, 4);
+  std::vector<uint8_t> expected(console.stateSize());
+  std::vector<uint8_t> actual(turbo.stateSize());
+  int failures = 0;
+  int hits = 0;
+
+  for (int i = 0; i < 40; i++) {
+    bool presented = fastForward.runFrame();
+
+    // Plain emulation a step at a time; the flag is cleared before the frame ends
+    bool hit = false;
+    console.ppu.frameComplete = 0;
+    while (!console.ppu.frameComplete) {
+      console.step();
+      hit = hit || BIT_VALUE(console.ppu.status, STATUS_SPRITE0_BIT);
+    }
+    if (hit) hits++;
+
+    if (presented != (i % 4 == 3)) {
+      printf("fastforward: frame %d %s\n", i, presented ? "presented early" : "not presented");
+      failures++;
+    }
+
+    console.saveState(expected.data(), expected.size());
+    turbo.saveState(actual.data(), actual.size());
+    if (expected != actual) {
+      printf("fastforward: frame %d state differs from plain emulation\n", i);
+      failures++;
+    }
+    if (presented && memcmp(console.ppu.framebuffer, turbo.ppu.framebuffer, FRAMEBUFFER_SIZE) != 0) {
+      printf("fastforward: frame %d shows the wrong picture\n", i);
+      failures++;
+    }
+  }
+
+  if (hits == 0) {
+    printf("fastforward: the test ROM never hit sprite 0\n");
+    failures++;
+  }
+  if (fastForward.frames() != 40) {
+    printf("fastforward: counted %llu frames\n", (unsigned long long)fastForward.frames());
+    failures++;
+  }
+
+  return failures;
+}
+
+// Lanes run in lockstep have to match plain emulation frame for frame, CPU
+// registers included, each with its own input
+static int testLockstep(Console& console) {
+  std::vector<uint8_t> rom = buildTestROM();
+  const int lanes = 4;
+  LockstepBatch* batch = new LockstepBatch();
+  Console* plain = new Console[lanes];
+  int failures = 0;
+
+  (*batch).loadROM(rom.data(), rom.size(), lanes);
+  for (int lane = 0; lane < lanes; lane++) plain[lane].loadROM(rom.data(), rom.size());
+
+  for (int frame = 0; frame < 30 && !failures; frame++) {
+    for (int lane = 0; lane < lanes; lane++) {
+      uint8_t buttons = (frame / 5) * (lane + 1);
+      (*batch).setButtons(lane, 0, buttons);
+      plain[lane].setButtons(0, buttons);
+      plain[lane].runFrame();
+    }
+    (*batch).runFrame();
+
+    for (int lane = 0; lane < lanes; lane++) {
+      Console& expected = plain[lane];
+      Console& actual = *(*batch).lanes[lane];
+      const CPU6502& e = expected.cpu;
+      const CPU6502& a = actual.cpu;
+
+      if (memcmp(expected.bus.ram, actual.bus.ram, RAM_SIZE) != 0) {
+        printf("lockstep: frame %d lane %d RAM differs\n", frame, lane);
+        failures++;
+      }
+      if (memcmp(expected.ppu.framebuffer, actual.ppu.framebuffer, FRAMEBUFFER_SIZE) != 0) {
+        printf("lockstep: frame %d lane %d picture differs\n", frame, lane);
+        failures++;
+      }
+      if (e.pc != a.pc || e.a != a.a || e.x != a.x || e.y != a.y || e.sp != a.sp || e.p != a.p || e.totalCycles != a.totalCycles) {
+        printf("lockstep: frame %d lane %d CPU at $%04X after %llu cycles, expected $%04X after %llu\n", frame, lane,
+          a.pc, (unsigned long long)a.totalCycles, e.pc, (unsigned long long)e.totalCycles);
+        failures++;
+      }
+    }
+  }
+
+  if ((*batch).vectorSteps == 0) {
+    printf("lockstep: nothing ran on the vector path\n");
+    failures++;
+  }
+
+  delete[] plain;
+  delete batch;
+  return failures;
+}
+
+// PRG-RAM writes land in the save file, and a later run starts from them
+static int testBatterySave(Console& console) {
+  const char* path = "bin/test.sav";
+  std::vector<uint8_t> rom = buildTestROM();
+  remove(path);
+  console.loadROM(rom.data(), rom.size());
+  int failures = 0;
+
+  BatterySave save;
+  if (!save.open(&console, path)) {
+    printf("battery: cannot map %s\n", path);
+    return 1;
+  }
+  if (console.bus.writePages[0x60] != console.cart.prgRam || console.cart.prgRam == console.cart.prgRamData) {
+    printf("battery: the bus doesn't see the mapped RAM\n");
+    failures++;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    console.cpu.write(0x6000 + i * 0x0ff1, 0x40 + i);
+    console.runFrame();
+    save.sync();
+  }
+  if (!save.close() || console.cart.prgRam != console.cart.prgRamData || console.cart.prgRam[0x0ff1] != 0x41) {
+    printf("battery: closing didn't hand the contents back\n");
+    failures++;
+  }
+
+  std::vector<uint8_t> data(PRG_RAM_SIZE + 1);
+  FILE* f = fopen(path, "rb");
+  size_t length = f ? fread(data.data(), 1, data.size(), f) : 0;
+  if (f) fclose(f);
+  if (length != PRG_RAM_SIZE || data[0] != 0x40 || data[0x0ff1] != 0x41 || data[0x1fe2] != 0x42) {
+    printf("battery: the file holds %u bytes, not the writes\n", (unsigned)length);
+    failures++;
+  }
+
+  // A fresh ROM load clears the RAM, then the save brings it back
+  console.loadROM(rom.data(), rom.size());
+  if (!save.open(&console, path) || console.cpu.read(0x7fe2) != 0x42) {
+    printf("battery: reopening lost the save\n");
+    failures++;
+  }
+  console.loadROM(rom.data(), rom.size());
+  if (!save.close() || console.cpu.read(0x6000) != 0) {
+    printf("battery: a reloaded cartridge still uses the save\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// Each console in a batch matches one run on its own, with its observations
+// in the caller's buffer
+static int testEnv(Console& console) {
+  const uint32_t count = 5;
+  std::vector<uint8_t> rom = buildTestROM();
+  std::vector<uint8_t> observations(count * TNES_OBSERVATION_SIZE);
+  std::vector<uint8_t> buttons(count * 2);
+  int failures = 0;
+
+  TnesEnv* env = tnes_env_create(count, 3);
+  if (!env || tnes_env_count(env) != count || tnes_env_step(env, 0)) {
+    printf("env: a new batch isn't empty\n");
+    tnes_env_destroy(env);
+    return 1;
+  }
+  if (!tnes_env_load_rom(env, rom.data(), rom.size()) || tnes_env_set_observations(env, observations.data(), observations.size() - 1) ||
+      !tnes_env_set_observations(env, observations.data(), observations.size())) {
+    printf("env: cannot set up the batch\n");
+    tnes_env_destroy(env);
+    return 1;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    console.loadROM(rom.data(), rom.size());
+    for (int frame = 0; frame < 12; frame++) {
+      // Console 3 starts its episode again halfway
+      if (i == 0 && frame == 6) tnes_env_reset(env, 3);
+      if (i == 3 && frame == 6) console.powerOn();
+
+      for (uint32_t j = 0; j < count; j++) buttons[j * 2] = (uint8_t)(j * 37 + frame * 11);
+      if (i == 0) tnes_env_step(env, buttons.data());
+      console.setButtons(0, buttons[i * 2]);
+      console.setButtons(1, 0);
+      console.runFrame();
+    }
+
+    const uint8_t* observation = &observations[i * TNES_OBSERVATION_SIZE];
+    if (memcmp(observation, console.ppu.framebuffer, FRAMEBUFFER_SIZE) != 0 ||
+        memcmp(observation + TNES_OBSERVATION_FRAMEBUFFER, console.bus.ram, RAM_SIZE) != 0) {
+      printf("env: console %u doesn't match a plain run\n", i);
+      failures++;
+    }
+  }
+
+  // Detaching leaves the last picture with the console
+  uint8_t last = observations[TNES_OBSERVATION_SIZE + 1000];
+  tnes_env_set_observations(env, 0, 0);
+  observations[TNES_OBSERVATION_SIZE + 1000] ^= 0xff;
+  tnes_env_step(env, 0);
+  if (observations[TNES_OBSERVATION_SIZE + 1000] == last) {
+    printf("env: a detached buffer is still written\n");
+    failures++;
+  }
+
+  tnes_env_destroy(env);
+  return failures;
+}
+
+// The test ROM only writes to the PPU, so moving those writes to their exact
+// cycle changes nothing the CPU can see. Both engines also stop on the same
+// instruction boundary, so they can take turns on one console.
+static int testCycleEngine(Console& console) {
+  std::vector<uint8_t> rom = buildTestROM();
+  Console stepped;
+  console.loadROM(rom.data(), rom.size());
+  stepped.loadROM(rom.data(), rom.size());
+  CycleEngine engine(&stepped);
+  int failures = 0;
+
+  for (int frame = 0; frame < 30; frame++) {
+    console.setButtons(0, frame * 5);
+    stepped.setButtons(0, frame * 5);
+    console.runFrame();
+    if (frame % 10 == 9) {
+      stepped.runFrame();
+    } else {
+      engine.runFrame();
+    }
+
+    if (memcmp(static_cast<CPURegisters*>(&console.cpu), static_cast<CPURegisters*>(&stepped.cpu), sizeof(CPURegisters)) != 0 ||
+        memcmp(console.bus.ram, stepped.bus.ram, RAM_SIZE) != 0 || console.ppu.scanline != stepped.ppu.scanline ||
+        console.ppu.dot != stepped.ppu.dot) {
+      printf("cycle engine: frame %d ended at a different point ($%04X, line %d)\n", frame, stepped.cpu.pc, stepped.ppu.scanline);
+      failures++;
+      break;
+    }
+  }
+
+  return failures;
+}
+
+static void writeVRAM(Console& console, uint16_t address, uint8_t value) {
+  console.ppu.writeRegister(0x2006, address >> 8);
+  console.ppu.writeRegister(0x2006, address & 0xff);
+  console.ppu.writeRegister(0x2007, value);
+}
+
+// Each nametable written through $2007 lands where the mirroring mode says,
+// including after a mapper switches modes, and four-screen VRAM is saved
+static int testMirroring(Console& console) {
+  std::vector<uint8_t> rom = buildTestROM();
+  int failures = 0;
+
+  // Header flags 6, then the expected home of $2000, $2400, $2800 and $2C00:
+  // 0 and 1 are the console's tables, 2 and 3 the cartridge's
+  const struct { uint8_t flags; int tables[4]; } cases[] = {
+    { 0x00, { 0, 0, 1, 1 } },
+    { 0x01, { 0, 1, 0, 1 } },
+    { 0x08, { 0, 1, 2, 3 } },
+  };
+
+  for (const auto& c : cases) {
+    rom[6] = c.flags;
+    console.loadROM(rom.data(), rom.size());
+
+    for (int table = 0; table < 4; table++) {
+      writeVRAM(console, 0x2000 + table * 0x400 + 5, 0x10 + table);
+      int home = c.tables[table];
+      uint8_t* memory = home < 2 ? &console.ppu.vram[home * NAMETABLE_SIZE] : &console.cart.nametableRam[(home - 2) * NAMETABLE_SIZE];
+      if (memory[5] != 0x10 + table) {
+        printf("mirroring: flags $%02X put table %d somewhere else\n", c.flags, table);
+        failures++;
+      }
+    }
+  }
+
+  // The mirror at $3000 and a switch to single screen
+  rom[6] = 0x01;
+  console.loadROM(rom.data(), rom.size());
+  console.cart.setMirroring(SingleScreenHigh);
+  writeVRAM(console, 0x3805, 0x42);
+  console.ppu.writeRegister(0x2006, 0x2c);
+  console.ppu.writeRegister(0x2006, 0x05);
+  console.ppu.readRegister(0x2007);
+  if (console.ppu.vram[NAMETABLE_SIZE + 5] != 0x42 || console.ppu.readRegister(0x2007) != 0x42) {
+    printf("mirroring: single screen doesn't share the second table\n");
+    failures++;
+  }
+
+  // The switched mode is part of the savestate
+  std::vector<uint8_t> switched(console.stateSize());
+  console.saveState(switched.data(), switched.size());
+  console.cart.setMirroring(Vertical);
+  console.loadState(switched.data(), switched.size());
+  writeVRAM(console, 0x2007, 0x55);
+  console.ppu.writeRegister(0x2006, 0x24);
+  console.ppu.writeRegister(0x2006, 0x07);
+  console.ppu.readRegister(0x2007);
+  if (console.cart.mirroring != SingleScreenHigh || console.ppu.readRegister(0x2007) != 0x55) {
+    printf("mirroring: a savestate doesn't bring back the switched mode\n");
+    failures++;
+  }
+
+  // Four-screen VRAM round trips through a savestate
+  rom[6] = 0x08;
+  console.loadROM(rom.data(), rom.size());
+  writeVRAM(console, 0x2c10, 0x99);
+  std::vector<uint8_t> state(console.stateSize());
+  console.saveState(state.data(), state.size());
+  writeVRAM(console, 0x2c10, 0x00);
+  if (!console.loadState(state.data(), state.size()) || console.cart.nametableRam[NAMETABLE_SIZE + 0x10] != 0x99) {
+    printf("mirroring: four-screen VRAM isn't in the savestate\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// The latency ROM polls the pad in the NMI handler at the end of a frame and
+// shows it from the next one, so changes are read one frame on and seen two
+static int testLatency(Console& console) {
+  std::vector<uint8_t> rom = buildLatencyROM();
+  console.loadROM(rom.data(), rom.size());
+  LatencyMeter meter(&console);
+  int failures = 0;
+  uint32_t changes = 0;
+
+  for (int frame = 0; frame < 60; frame++) {
+    uint8_t buttons = (frame / 6) << 4;
+    if (frame % 6 == 0 && frame > 0) changes++;
+    meter.input(0, buttons);
+    meter.beginFrame();
+    console.runFrame();
+    meter.endFrame();
+    if (frame % 2 == 1) meter.presented();
+  }
+
+  const LatencyHistogram* stages = meter.stages;
+  if (stages[LATENCY_POLL].count != changes || stages[LATENCY_POLL].frames[1] != changes) {
+    printf("latency: %u of %u changes polled in the next frame\n", stages[LATENCY_POLL].frames[1], changes);
+    failures++;
+  }
+  if (stages[LATENCY_FRAME].count != changes || stages[LATENCY_FRAME].frames[2] != changes) {
+    printf("latency: %u of %u changes shown two frames on\n", stages[LATENCY_FRAME].frames[2], changes);
+    failures++;
+  }
+
+  // Only odd frames are presented, which is where the changes show
+  if (stages[LATENCY_PRESENT].count != changes || stages[LATENCY_PRESENT].frames[2] != changes || meter.dropped) {
+    printf("latency: %u of %u changes presented as they show\n", stages[LATENCY_PRESENT].frames[2], changes);
+    failures++;
+  }
+  if (stages[LATENCY_PRESENT].totalMicros < stages[LATENCY_FRAME].totalMicros) {
+    printf("latency: frames were presented before they were drawn\n");
+    failures++;
+  }
+
+  // Changes made straight on the console are caught at the next frame
+  console.setButtons(1, BUTTON_START);
+  meter.beginFrame();
+  console.runFrame();
+  meter.endFrame();
+  if (stages[LATENCY_POLL].count != changes + 1) {
+    printf("latency: a change behind the meter's back was missed\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+#ifdef CPU_DEBUG
+// Breakpoints and watchpoints stop where they should, and a debugger with
+// nothing hit leaves emulation exactly as it was
+static int testDebugger(Console& console) {
+  std::vector<uint8_t> rom = buildTestROM();
+  Console plain;
+  console.loadROM(rom.data(), rom.size());
+  plain.loadROM(rom.data(), rom.size());
+  int failures = 0;
+
+  Debugger debugger(&console);
+
+  // Loop at $C00E increments $20 once per pass
+  debugger.setBreakpoint(0xc00e, true);
+  uint8_t before = console.bus.ram[0x20];
+  for (int i = 0; i < 3; i++) {
+    uint8_t reason = debugger.runFrame();
+    if (reason != STOP_BREAKPOINT || debugger.stopPC != 0xc00e || console.cpu.pc != 0xc00e) {
+      printf("debugger: pass %d stopped with %d at $%04X\n", i, reason, console.cpu.pc);
+      failures++;
+    }
+  }
+  if (console.bus.ram[0x20] != (uint8_t)(before + 2)) {
+    printf("debugger: loop ran %d times between breakpoints\n", console.bus.ram[0x20] - before);
+    failures++;
+  }
+
+  // Stepping off a breakpoint executes it
+  if (debugger.step() != STOP_NONE || console.cpu.pc != 0xc010) {
+    printf("debugger: step went to $%04X\n", console.cpu.pc);
+    failures++;
+  }
+  debugger.setBreakpoint(0xc00e, false);
+
+  // A watchpoint on a mirror catches the zero page write, and unmaps every mirror
+  debugger.setWatchpoint(0x0820, WATCH_WRITE);
+  if (console.bus.readPages[0x00] || console.bus.writePages[0x18] || !console.bus.readPages[0x01]) {
+    printf("debugger: watched pages are still mapped\n");
+    failures++;
+  }
+  uint8_t reason = debugger.runFrame();
+  if (reason != STOP_WATCH_WRITE || debugger.stopAddress != 0x20 || debugger.stopPC != 0xc00e ||
+      debugger.stopValue != console.bus.ram[0x20]) {
+    printf("debugger: write watch stopped with %d at $%04X\n", reason, debugger.stopPC);
+    failures++;
+  }
+  debugger.setWatchpoint(0x0020, 0);
+  if (!console.bus.readPages[0x00] || !console.bus.writePages[0x18]) {
+    printf("debugger: unwatched pages aren't mapped again\n");
+    failures++;
+  }
+
+  // The NMI handler polls the controller
+  debugger.setWatchpoint(0x4016, WATCH_READ);
+  for (int i = 0; i < 3 && (reason = debugger.runFrame()) == STOP_FRAME; i++);
+  if (reason != STOP_WATCH_READ || debugger.stopAddress != 0x4016 || debugger.stopPC != 0xc02e) {
+    printf("debugger: read watch stopped with %d at $%04X\n", reason, debugger.stopPC);
+    failures++;
+  }
+
+  // Watching and breaking on addresses the program never touches changes nothing
+  debugger.clear();
+  console.loadROM(rom.data(), rom.size());
+  debugger.setBreakpoint(0xd000, true);
+  debugger.setWatchpoint(0x0300, WATCH_READ | WATCH_WRITE);
+  for (int i = 0; i < 20; i++) {
+    reason = debugger.runFrame();
+    plain.runFrame();
+    if (reason != STOP_FRAME) {
+      printf("debugger: frame %d stopped with %d\n", i, reason);
+      failures++;
+      break;
+    }
+  }
+
+  std::vector<uint8_t> expected(plain.stateSize());
+  std::vector<uint8_t> actual(console.stateSize());
+  plain.saveState(expected.data(), expected.size());
+  console.saveState(actual.data(), actual.size());
+  if (expected != actual) {
+    printf("debugger: state differs from plain emulation\n");
+    failures++;
+  }
+
+  return failures;
+}
+#endif
+
+#if defined(CPU_PROFILE) || defined(CPU_HEATMAP) || defined(CPU_TRACE)
+// Run a program from work RAM for a number of instructions
+static void runProgram(Console& console, uint16_t origin, const uint8_t* program, size_t size, int steps) {
+  memcpy(&console.bus.ram[origin], program, size);
+  console.cpu.a = console.cpu.x = console.cpu.y = 0;
+  console.cpu.p = 0x24;
+  console.cpu.sp = 0xfd;
+  console.cpu.pc = origin;
+  console.cpu.totalCycles = 0;
+  for (int i = 0; i < steps; i++) console.step();
+}
+#endif
+
+#if defined(CPU_HEATMAP) || defined(CPU_TRACE)
+// Whole file, or nothing; the file is removed
+static std::vector<uint8_t> takeFile(const char* path) {
+  std::vector<uint8_t> data;
+  if (!readFile(path, data)) data.clear();
+  remove(path);
+  return data;
+}
+#endif
+
+#ifdef CPU_PROFILE
+// Page crosses are counted only where they cost a cycle
+static int testProfile(Console& console) {
+  const uint8_t program[] = {
+    0xa2, 0x20,       // $0200 LDX #$20
+    0xbd, 0xf0, 0x01, //       LDA $01F0,X  crosses, pays
+    0x9d, 0xf0, 0x01, //       STA $01F0,X  crosses, never pays
+    0xbd, 0x00, 0x01, //       LDA $0100,X  doesn't cross
+    0x4c, 0xf0, 0x02, //       JMP $02F0
+  };
+  const uint8_t branches[] = {
+    0xd0, 0x20,       // $02F0 BNE $0312    taken across a page
+  };
+  const uint8_t branchBack[] = {
+    0xd0, 0x02,       // $0312 BNE $0316    taken within the page
+  };
+  int failures = 0;
+
+  memset(console.bus.ram, 0, sizeof(console.bus.ram));
+  console.bus.ram[0x0120] = 0x01;
+  memcpy(&console.bus.ram[0x02f0], branches, sizeof(branches));
+  memcpy(&console.bus.ram[0x0312], branchBack, sizeof(branchBack));
+  OpcodeProfile::reset();
+  runProgram(console, 0x0200, program, sizeof(program), 7);
+
+  const struct { uint8_t opcode; uint64_t executions; uint64_t crosses; } expected[] = {
+    { 0xbd, 2, 1 },
+    { 0x9d, 1, 0 },
+    { 0xd0, 2, 1 },
+  };
+  for (const auto& e : expected) {
+    if (OpcodeProfile::executions[e.opcode] != e.executions || OpcodeProfile::pageCrosses[e.opcode] != e.crosses) {
+      printf("profile: %02X ran %llu times with %llu crosses, expected %llu and %llu\n", e.opcode,
+        (unsigned long long)OpcodeProfile::executions[e.opcode], (unsigned long long)OpcodeProfile::pageCrosses[e.opcode],
+        (unsigned long long)e.executions, (unsigned long long)e.crosses);
+      failures++;
+    }
+  }
+  if (console.cpu.pc != 0x0316) {
+    printf("profile: program ended at $%04X\n", console.cpu.pc);
+    failures++;
+  }
+
+  return failures;
+}
+#endif
+
+#ifdef CPU_HEATMAP
+// A counted loop shows up per PC, as one backward branch, and in all three
+// exports
+static int testHeatmap(Console& console) {
+  const uint8_t program[] = {
+    0xa2, 0x05,       // $0200 LDX #$05
+    0xca,             // $0202 DEX
+    0xd0, 0xfd,       // $0203 BNE $0202
+  };
+  int failures = 0;
+
+  Heatmap::reset();
+  runProgram(console, 0x0200, program, sizeof(program), 11);
+
+  if (Heatmap::executions[0x0200] != 1 || Heatmap::executions[0x0202] != 5 || Heatmap::executions[0x0203] != 5 || Heatmap::executions[0x0205] != 0) {
+    printf("heatmap: executions %llu %llu %llu at $0200, $0202 and $0203\n", (unsigned long long)Heatmap::executions[0x0200],
+      (unsigned long long)Heatmap::executions[0x0202], (unsigned long long)Heatmap::executions[0x0203]);
+    failures++;
+  }
+  if (Heatmap::loopTrips[0x0203] != 4 || Heatmap::loopTargets[0x0203] != 0x0202) {
+    printf("heatmap: loop at $0203 taken %llu times to $%04X\n", (unsigned long long)Heatmap::loopTrips[0x0203], Heatmap::loopTargets[0x0203]);
+    failures++;
+  }
+
+  // The loop is the only one, so its row is the whole file
+  const char* loopsPath = "bin/test-loops.csv";
+  const char* expectedLoops = "target,branch,trips,executions\n0202,0203,4,5\n";
+  std::vector<uint8_t> loops = Heatmap::exportLoops(loopsPath) ? takeFile(loopsPath) : std::vector<uint8_t>();
+  if (loops.size() != strlen(expectedLoops) || memcmp(loops.data(), expectedLoops, loops.size()) != 0) {
+    printf("heatmap: loop export is \"%.*s\"\n", (int)loops.size(), (const char*)loops.data());
+    failures++;
+  }
+
+  const char* csvPath = "bin/test-heatmap.csv";
+  std::vector<uint8_t> csv = Heatmap::exportCSV(csvPath) ? takeFile(csvPath) : std::vector<uint8_t>();
+  csv.push_back('\0');
+  const char* text = (const char*)csv.data();
+  if (strncmp(text, "address,executions,reads,writes\n", 32) != 0 || !strstr(text, "\n0202,5,") || !strstr(text, "\n0203,5,") || strstr(text, "\n0205,")) {
+    printf("heatmap: CSV export is missing the loop\n");
+    failures++;
+  }
+
+  const char* binaryPath = "bin/test-heatmap.bin";
+  std::vector<uint8_t> binary = Heatmap::exportBinary(binaryPath) ? takeFile(binaryPath) : std::vector<uint8_t>();
+  HeatmapHeader header = {};
+  uint64_t executions = 0;
+  if (binary.size() == sizeof(header) + 3 * sizeof(Heatmap::executions)) {
+    memcpy(&header, binary.data(), sizeof(header));
+    memcpy(&executions, &binary[sizeof(header) + 0x0202 * sizeof(uint64_t)], sizeof(executions));
+  }
+  if (memcmp(header.magic, "TNHM", 4) != 0 || header.addresses != ADDRESS_SPACE || header.arrays != 3 || executions != 5) {
+    printf("heatmap: binary export has %llu executions at $0202\n", (unsigned long long)executions);
+    failures++;
+  }
+
+  return failures;
+}
+#endif
+
+#ifdef CPU_TRACE
+// Records decode to nestest.log lines, and a ring smaller than the run keeps
+// the last records, oldest first
+static int testTrace(Console& console) {
+  const uint8_t program[] = {
+    0xa2, 0x05,       // $0200 LDX #$05
+    0xca,             // $0202 DEX
+    0xd0, 0xfd,       // $0203 BNE $0202
+  };
+  const char* expected[] = {
+    "0202  CA        DEX                             A:00 X:02 Y:00 P:24 SP:FD CYC:17",
+    "0203  D0 FD     BNE $0202                       A:00 X:01 Y:00 P:24 SP:FD CYC:19",
+    "0202  CA        DEX                             A:00 X:01 Y:00 P:24 SP:FD CYC:22",
+    "0203  D0 FD     BNE $0202                       A:00 X:00 Y:00 P:26 SP:FD CYC:24",
+  };
+  const char* path = "bin/test.trace";
+  char line[TRACE_LINE_SIZE];
+  int failures = 0;
+
+  // Unofficial opcodes are starred, and the cycle count keeps 48 bits
+  TraceRecord record = { 0xc000, 0xa7, { 0x10, 0x00 }, 0x12, 0x34, 0x56, 0xa5, 0xfb, { 0x9a, 0x78, 0x56, 0x34, 0x12, 0x00 } };
+  formatTrace(record, line, sizeof(line));
+  if (strcmp(line, "C000  A7 10    *LAX $10                         A:12 X:34 Y:56 P:A5 SP:FB CYC:78187493530") != 0) {
+    printf("trace: formatted as \"%s\"\n", line);
+    failures++;
+  }
+  record = { 0xc003, 0xbd, { 0xf0, 0x01 }, 0x00, 0x20, 0x00, 0x24, 0xfd, { 7 } };
+  formatTrace(record, line, sizeof(line));
+  if (strcmp(line, "C003  BD F0 01  LDA $01F0,X                     A:00 X:20 Y:00 P:24 SP:FD CYC:7") != 0) {
+    printf("trace: formatted as \"%s\"\n", line);
+    failures++;
+  }
+
+  // Eleven instructions through a four record ring
+  TraceRing ring;
+  if (!ring.open(path, 3)) {
+    printf("trace: cannot create %s\n", path);
+    return failures + 1;
+  }
+  CPU6502::trace = &ring;
+  runProgram(console, 0x0200, program, sizeof(program), 11);
+  CPU6502::trace = 0;
+  ring.close();
+
+  std::vector<uint8_t> file = takeFile(path);
+  TraceHeader header = {};
+  if (file.size() == sizeof(header) + 4 * sizeof(TraceRecord)) memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, "TNTR", 4) != 0 || header.recordSize != sizeof(TraceRecord) || header.capacity != 4 || header.head != 11) {
+    printf("trace: ring of %u records holds %llu\n", header.capacity, (unsigned long long)header.head);
+    return failures + 1;
+  }
+
+  const TraceRecord* records = (const TraceRecord*)&file[sizeof(header)];
+  for (uint64_t i = header.head - 4; i < header.head; i++) {
+    formatTrace(records[i & 3], line, sizeof(line));
+    if (strcmp(line, expected[i - (header.head - 4)]) != 0) {
+      printf("trace: record %llu is \"%s\"\n", (unsigned long long)i, line);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+#endif
 
 int main() {
-  Bus b = Bus();
-  CPU6502 cpu = CPU6502();
+  Console console;
+
+  int failures = testOpcodeTable(console);
+  printf("opcode table: %s (%d failures)\n", failures ? "FAIL" : "ok", failures);
+
+  int instructionFailures = testInstructions(console);
+  printf("instructions: %s (%d failures)\n", instructionFailures ? "FAIL" : "ok", instructionFailures);
+  failures += instructionFailures;
+
+  int savestateFailures = testSavestate(console);
+  printf("savestate: %s (%d failures)\n", savestateFailures ? "FAIL" : "ok", savestateFailures);
+  failures += savestateFailures;
+
+  int rewindFailures = testRewind(console);
+  printf("rewind: %s (%d failures)\n", rewindFailures ? "FAIL" : "ok", rewindFailures);
+  failures += rewindFailures;
+
+  int runAheadFailures = testRunAhead(console);
+  printf("runahead: %s (%d failures)\n", runAheadFailures ? "FAIL" : "ok", runAheadFailures);
+  failures += runAheadFailures;
+
+  int movieFailures = testMovie(console);
+  printf("movie: %s (%d failures)\n", movieFailures ? "FAIL" : "ok", movieFailures);
+  failures += movieFailures;
+
+  int frameHashFailures = testFrameHash(console);
+  printf("framehash: %s (%d failures)\n", frameHashFailures ? "FAIL" : "ok", frameHashFailures);
+  failures += frameHashFailures;
+
+  int videoFailures = testVideo(console);
+  printf("video: %s (%d failures)\n", videoFailures ? "FAIL" : "ok", videoFailures);
+  failures += videoFailures;
+
+  int fastForwardFailures = testFastForward(console);
+  printf("fastforward: %s (%d failures)\n", fastForwardFailures ? "FAIL" : "ok", fastForwardFailures);
+  failures += fastForwardFailures;
+
+  int lockstepFailures = testLockstep(console);
+  printf("lockstep: %s (%d failures)\n", lockstepFailures ? "FAIL" : "ok", lockstepFailures);
+  failures += lockstepFailures;
+
+  int batteryFailures = testBatterySave(console);
+  printf("battery: %s (%d failures)\n", batteryFailures ? "FAIL" : "ok", batteryFailures);
+  failures += batteryFailures;
+
+  int envFailures = testEnv(console);
+  printf("env: %s (%d failures)\n", envFailures ? "FAIL" : "ok", envFailures);
+  failures += envFailures;
+
+  int cycleFailures = testCycleEngine(console);
+  printf("cycle engine: %s (%d failures)\n", cycleFailures ? "FAIL" : "ok", cycleFailures);
+  failures += cycleFailures;
+
+  int mirroringFailures = testMirroring(console);
+  printf("mirroring: %s (%d failures)\n", mirroringFailures ? "FAIL" : "ok", mirroringFailures);
+  failures += mirroringFailures;
+
+  int latencyFailures = testLatency(console);
+  printf("latency: %s (%d failures)\n", latencyFailures ? "FAIL" : "ok", latencyFailures);
+  failures += latencyFailures;
+
+#ifdef CPU_DEBUG
+  int debuggerFailures = testDebugger(console);
+  printf("debugger: %s (%d failures)\n", debuggerFailures ? "FAIL" : "ok", debuggerFailures);
+  failures += debuggerFailures;
+#endif
+
+#ifdef CPU_PROFILE
+  int profileFailures = testProfile(console);
+  printf("profile: %s (%d failures)\n", profileFailures ? "FAIL" : "ok", profileFailures);
+  failures += profileFailures;
+#endif
+
+#ifdef CPU_HEATMAP
+  int heatmapFailures = testHeatmap(console);
+  printf("heatmap: %s (%d failures)\n", heatmapFailures ? "FAIL" : "ok", heatmapFailures);
+  failures += heatmapFailures;
+#endif
 
-  b.cpu = cpu;
-  cpu.connectToBus(&b);
+#ifdef CPU_TRACE
+  int traceFailures = testTrace(console);
+  printf("trace: %s (%d failures)\n", traceFailures ? "FAIL" : "ok", traceFailures);
+  failures += traceFailures;
+#endif
 
-  return 0;
+  return failures ? 1 : 0;
 }
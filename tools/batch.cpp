@@ -0,0 +1,419 @@
+// nes-batch: run many independent ROM jobs across all cores.
+//
+// Usage: nes-batch [-j threads] [-l] [-u] [-R] [-s save-dir] [-t trace-file] [-H heatmap-prefix] manifest
+//
+// Each manifest line is "rom movie frames [hashes]", where movie is a movie
+// file (see Movie.h), a raw file with one controller byte per frame for port
+// 1, or "-" for no input. Blank lines and lines starting with # are ignored.
+// One line per job is printed, in manifest order: "index status ram-hash
+// frame-hash rom".
+//
+// A job with a hashes file has every frame hashed and checked against that
+// golden hash log (see HashLog in FrameHash.h); the first frame that differs
+// is reported as "index mismatch frame rom". -u writes the logs instead of
+// checking them, and -R includes work RAM in the hashes.
+//
+// With -s, jobs whose cartridge has a battery keep their PRG-RAM in
+// save-dir/index.sav, where index is the job's line in the output. The file
+// is mapped as the RAM (see BatterySave.h) and synced once per frame, so a
+// restarted batch carries on from the saves the last one left.
+//
+// Jobs without a hashes file only render their last frame, fast-forwarding
+// through the rest (see FastForward.h); the results are the same.
+//
+// Every worker owns a single Console that it reuses for each job it runs, and
+// nothing mutable is shared between workers apart from the job queues.
+//
+// With -l, jobs with the same ROM and frame count are grouped and run in
+// lockstep, up to LOCKSTEP_LANES of them per LockstepBatch. The output is
+// identical to the default mode.
+//
+// In a TRACE=1 build, -t records the last TRACE_RECORDS instructions into a
+// ring file for nes-trace to decode. Tracing runs on one thread, without -l.
+// A PROFILE=1 build does the same and prints the opcode profile at exit.
+// A HEATMAP=1 build also does, and with -H writes prefix.csv, prefix.bin and
+// prefix-loops.csv (see Heatmap in Profile.h).
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BatterySave.h"
+#include "Console.h"
+#include "FastForward.h"
+#include "FrameHash.h"
+#include "Lockstep.h"
+#include "Movie.h"
+#include "Profile.h"
+#include "common.h"
+
+#define TRACE_RECORDS (1 << 20)
+
+struct Job {
+  std::string rom;
+  std::string movie;
+  uint32_t frames;
+  std::string hashes;
+};
+
+struct Result {
+  bool ok;
+  const char* error;
+  uint64_t ramHash;
+  uint64_t frameHash;
+  uint32_t mismatch;
+};
+
+// A unit of work: one job, or a group of jobs run in lockstep
+typedef std::vector<size_t> WorkItem;
+
+// Per-worker deque. The owner pops from the back, thieves take from the front.
+struct WorkQueue {
+  std::mutex lock;
+  std::deque<size_t> items;
+};
+
+// Set once from the command line
+static bool updateHashes = false;
+static uint16_t hashFlags = 0;
+static const char* saveDir = 0;
+
+// Movie files are used as they are, anything else is taken as raw input
+static bool readMovie(const std::string& path, Movie& movie) {
+  movie.clear();
+  if (path == "-") return true;
+
+  std::vector<uint8_t> data;
+  if (!readFile(path.c_str(), data)) return false;
+  if (movie.load(data.data(), data.size())) return true;
+
+  for (uint8_t buttons : data) movie.record(buttons, 0);
+  return true;
+}
+
+static bool writeFile(const char* path, const uint8_t* data, size_t size) {
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  bool ok = fwrite(data, 1, size, f) == size;
+  return fclose(f) == 0 && ok;
+}
+
+static bool parseManifest(const char* path, std::vector<Job>& jobs) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+
+  char line[4096];
+  int lineNumber = 0;
+  while (fgets(line, sizeof(line), f)) {
+    lineNumber++;
+    char rom[2048], movie[2048], hashes[2048] = "";
+    unsigned frames;
+
+    char* start = line + strspn(line, " \t");
+    if (*start == '#' || *start == '\n' || *start == '\0') continue;
+
+    if (sscanf(start, "%2047s %2047s %u %2047s", rom, movie, &frames, hashes) < 3) {
+      fprintf(stderr, "%s:%d: expected \"rom movie frames [hashes]\"\n", path, lineNumber);
+      fclose(f);
+      return false;
+    }
+    jobs.push_back({ rom, movie, frames, hashes });
+  }
+
+  fclose(f);
+  return true;
+}
+
+// Map the job's save file over a battery-backed cartridge's PRG-RAM
+static bool openSave(Console& console, size_t index, BatterySave& save) {
+  if (!saveDir || !console.cart.battery) return true;
+  std::string path = std::string(saveDir) + "/" + std::to_string(index) + ".sav";
+  return save.open(&console, path.c_str());
+}
+
+// Final hashes, and the job's hash log written out or checked
+static Result finishJob(Console& console, const Job& job, HashLog& log) {
+  Result result = {
+    true,
+    0,
+    hash64(console.bus.ram, sizeof(console.bus.ram), 0),
+    hash64(console.ppu.framebuffer, FRAMEBUFFER_SIZE, 0),
+    HASHLOG_MATCH
+  };
+  if (job.hashes.empty()) return result;
+
+  std::vector<uint8_t> data;
+  if (updateHashes) {
+    data.resize(log.size());
+    log.save(data.data(), data.size());
+    if (!writeFile(job.hashes.c_str(), data.data(), data.size())) return { false, "cannot write hashes", 0, 0, 0 };
+    return result;
+  }
+
+  HashLog golden;
+  if (!readFile(job.hashes.c_str(), data) || !golden.load(data.data(), data.size())) return { false, "cannot read hashes", 0, 0, 0 };
+  result.mismatch = log.compare(golden);
+  return result;
+}
+
+static Result runJob(Console& console, const Job& job, size_t index) {
+  std::vector<uint8_t> rom;
+  Movie movie;
+  HashLog log;
+  BatterySave save;
+  log.flags = hashFlags;
+
+  if (!readFile(job.rom.c_str(), rom)) return { false, "cannot read rom", 0, 0, 0 };
+  if (!readMovie(job.movie, movie)) return { false, "cannot read movie", 0, 0, 0 };
+  if (!console.loadROM(rom.data(), rom.size())) return { false, "unsupported rom", 0, 0, 0 };
+  if (!openSave(console, index, save)) return { false, "cannot map save", 0, 0, 0 };
+
+  FastForward fastForward(&console, job.hashes.empty() ? job.frames : 1);
+  for (uint32_t frame = 0; frame < job.frames; frame++) {
+    movie.play(console);
+    fastForward.runFrame();
+    save.sync();
+    if (!job.hashes.empty()) log.record(console);
+  }
+
+  if (!save.close()) return { false, "cannot write save", 0, 0, 0 };
+  return finishJob(console, job, log);
+}
+
+static void runLockstep(LockstepBatch& batch, const std::vector<Job>& jobs, const WorkItem& item, std::vector<Result>& results) {
+  const Job& first = jobs[item[0]];
+  std::vector<uint8_t> rom;
+  std::vector<Movie> movies(item.size());
+  std::vector<HashLog> logs(item.size());
+  std::vector<BatterySave> saves(item.size());
+  for (HashLog& log : logs) log.flags = hashFlags;
+
+  const char* error = 0;
+  if (!readFile(first.rom.c_str(), rom)) error = "cannot read rom";
+  for (size_t lane = 0; lane < item.size() && !error; lane++) {
+    const Job& job = jobs[item[lane]];
+    if (!readMovie(job.movie, movies[lane])) error = "cannot read movie";
+  }
+  if (!error && !batch.loadROM(rom.data(), rom.size(), item.size())) error = "unsupported rom";
+  for (size_t lane = 0; lane < item.size() && !error; lane++) {
+    if (!openSave(*batch.lanes[lane], item[lane], saves[lane])) error = "cannot map save";
+  }
+
+  if (error) {
+    for (size_t job : item) results[job] = { false, error, 0, 0, 0 };
+    return;
+  }
+
+  // Lanes fast-forward like runJob does, with skipRender set directly since
+  // the batch runs the frame
+  for (uint32_t frame = 0; frame < first.frames; frame++) {
+    for (size_t lane = 0; lane < item.size(); lane++) {
+      movies[lane].play(*batch.lanes[lane]);
+      (*batch.lanes[lane]).ppu.skipRender = jobs[item[lane]].hashes.empty() && frame + 1 < first.frames;
+    }
+    batch.runFrame();
+
+    for (size_t lane = 0; lane < item.size(); lane++) {
+      saves[lane].sync();
+      if (!jobs[item[lane]].hashes.empty()) logs[lane].record(*batch.lanes[lane]);
+    }
+  }
+
+  for (size_t lane = 0; lane < item.size(); lane++) {
+    if (!saves[lane].close()) {
+      results[item[lane]] = { false, "cannot write save", 0, 0, 0 };
+      continue;
+    }
+    results[item[lane]] = finishJob(*batch.lanes[lane], jobs[item[lane]], logs[lane]);
+  }
+}
+
+static bool takeItem(std::vector<WorkQueue>& queues, size_t self, size_t& item) {
+  {
+    std::lock_guard<std::mutex> guard(queues[self].lock);
+    if (!queues[self].items.empty()) {
+      item = queues[self].items.back();
+      queues[self].items.pop_back();
+      return true;
+    }
+  }
+
+  // Work is all queued up front, so once every queue is empty we're done
+  for (size_t i = 1; i < queues.size(); i++) {
+    WorkQueue& victim = queues[(self + i) % queues.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.items.empty()) {
+      item = victim.items.front();
+      victim.items.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+static void worker(std::vector<WorkQueue>& queues, size_t self, const std::vector<Job>& jobs, const std::vector<WorkItem>& items, bool lockstep, std::vector<Result>& results) {
+  Console* console = lockstep ? 0 : new Console();
+  LockstepBatch* batch = lockstep ? new LockstepBatch() : 0;
+
+  size_t item;
+  while (takeItem(queues, self, item)) {
+    if (lockstep) {
+      runLockstep(*batch, jobs, items[item], results);
+    } else {
+      results[items[item][0]] = runJob(*console, jobs[items[item][0]], items[item][0]);
+    }
+  }
+
+  delete console;
+  delete batch;
+}
+
+// Group jobs that share a ROM and frame count, up to one batch each
+static void groupJobs(const std::vector<Job>& jobs, std::vector<WorkItem>& items) {
+  for (size_t i = 0; i < jobs.size(); i++) {
+    bool placed = false;
+    for (WorkItem& item : items) {
+      const Job& first = jobs[item[0]];
+      if (item.size() < LOCKSTEP_LANES && first.rom == jobs[i].rom && first.frames == jobs[i].frames) {
+        item.push_back(i);
+        placed = true;
+        break;
+      }
+    }
+    if (!placed) items.push_back(WorkItem(1, i));
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  const char* manifest = 0;
+  bool lockstep = false;
+  const char* tracePath = 0;
+  const char* heatmapPrefix = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-l") == 0) {
+      lockstep = true;
+    } else if (strcmp(argv[i], "-u") == 0) {
+      updateHashes = true;
+    } else if (strcmp(argv[i], "-R") == 0) {
+      hashFlags |= HASHLOG_RAM;
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      saveDir = argv[++i];
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      tracePath = argv[++i];
+    } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+      heatmapPrefix = argv[++i];
+    } else {
+      manifest = argv[i];
+    }
+  }
+
+  if (!manifest) {
+    fprintf(stderr, "usage: %s [-j threads] [-l] [-u] [-R] [-s save-dir] [-t trace-file] [-H heatmap-prefix] manifest\n", argv[0]);
+    return 2;
+  }
+
+  if (tracePath) {
+#ifdef CPU_TRACE
+    static TraceRing ring;
+    if (!ring.open(tracePath, TRACE_RECORDS)) {
+      fprintf(stderr, "cannot create trace %s\n", tracePath);
+      return 2;
+    }
+    CPU6502::trace = &ring;
+    threads = 1;
+    lockstep = false;
+#else
+    fprintf(stderr, "tracing needs a TRACE=1 build\n");
+    return 2;
+#endif
+  }
+
+#ifndef CPU_HEATMAP
+  if (heatmapPrefix) {
+    fprintf(stderr, "heatmaps need a HEATMAP=1 build\n");
+    return 2;
+  }
+#endif
+
+#if defined(CPU_PROFILE) || defined(CPU_HEATMAP)
+  // The profile counters are shared by the whole process
+  threads = 1;
+  lockstep = false;
+#endif
+
+  std::vector<Job> jobs;
+  if (!parseManifest(manifest, jobs)) {
+    fprintf(stderr, "cannot read manifest %s\n", manifest);
+    return 2;
+  }
+
+  std::vector<WorkItem> items;
+  if (lockstep) {
+    groupJobs(jobs, items);
+  } else {
+    for (size_t i = 0; i < jobs.size(); i++) items.push_back(WorkItem(1, i));
+  }
+
+  if (threads == 0) threads = 1;
+  if (threads > items.size()) threads = items.size() ? items.size() : 1;
+
+  // Deal the work out round robin; stealing evens out the rest
+  std::vector<WorkQueue> queues(threads);
+  for (size_t i = 0; i < items.size(); i++) {
+    queues[i % threads].items.push_back(i);
+  }
+
+  std::vector<Result> results(jobs.size());
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < threads; i++) {
+    pool.emplace_back(worker, std::ref(queues), i, std::cref(jobs), std::cref(items), lockstep, std::ref(results));
+  }
+  for (std::thread& t : pool) t.join();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  int failures = 0;
+  uint64_t frames = 0;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const Result& r = results[i];
+    if (r.ok && r.mismatch != HASHLOG_MATCH) {
+      printf("%zu mismatch %u %s\n", i, r.mismatch, jobs[i].rom.c_str());
+      failures++;
+    } else if (r.ok) {
+      printf("%zu ok %016llx %016llx %s\n", i, (unsigned long long)r.ramHash, (unsigned long long)r.frameHash, jobs[i].rom.c_str());
+      frames += jobs[i].frames;
+    } else {
+      printf("%zu error %s %s\n", i, r.error, jobs[i].rom.c_str());
+      failures++;
+    }
+  }
+
+  fprintf(stderr, "%zu jobs, %d failed, %u threads, %.3fs, %.0f frames/s\n",
+    jobs.size(), failures, threads, seconds, seconds > 0 ? frames / seconds : 0.0);
+
+#ifdef CPU_HEATMAP
+  if (heatmapPrefix) {
+    std::string prefix = heatmapPrefix;
+    if (!Heatmap::exportCSV((prefix + ".csv").c_str()) || !Heatmap::exportBinary((prefix + ".bin").c_str()) ||
+        !Heatmap::exportLoops((prefix + "-loops.csv").c_str())) {
+      fprintf(stderr, "cannot write heatmap %s\n", heatmapPrefix);
+      return 2;
+    }
+  }
+#endif
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,298 @@
+// nes-bench: microbenchmarks for the CPU core and bus, plus whole-ROM runs.
+//
+// Usage: nes-bench [-r repetitions] [rom ...]
+//
+// Every benchmark is repeated and reported as JSON on stdout with the median,
+// minimum, maximum and median absolute deviation of its rate, so two builds
+// can be compared by a script:
+//
+//   kernel/*  fixed 6502 loops run on the CPU alone, in emulated MHz
+//   bus/*     single memory accesses through the CPU and Bus paths, in
+//             millions of accesses per second
+//   hash/*    frameHash() over the framebuffer, and RAM too, in GB/s
+//   video/*   framebuffer conversion to RGBA and YUV420, in frames per second
+//   rom/*     frames per second with the PPU, for the built-in rendering
+//             kernel and each ROM given on the command line
+//   cycle/*   the same frames on the cycle-stepped engine (see Scheduler.h)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Console.h"
+#include "FrameHash.h"
+#include "Scheduler.h"
+#include "Video.h"
+#include "common.h"
+
+#define DEFAULT_REPETITIONS 7
+#define KERNEL_CYCLES 5000000
+#define BUS_ACCESSES 20000000
+#define ROM_FRAMES 300
+#define HASH_FRAMES 20000
+#define VIDEO_FRAMES 5000
+
+struct Kernel {
+  const char* name;
+  std::vector<uint8_t> code;
+};
+
+// All kernels start at $8000 and loop forever
+static const Kernel KERNELS[] = {
+  { "alu", {
+    0xa2, 0x00,       // $8000 LDX #$00
+    0x8a,             // $8002 TXA
+    0x69, 0x37,       //       ADC #$37
+    0x49, 0x5a,       //       EOR #$5A
+    0x29, 0xf0,       //       AND #$F0
+    0x09, 0x0f,       //       ORA #$0F
+    0x0a,             //       ASL A
+    0x6a,             //       ROR A
+    0xe9, 0x11,       //       SBC #$11
+    0xc9, 0x80,       //       CMP #$80
+    0xca,             //       DEX
+    0xd0, 0xee,       //       BNE $8002
+    0x4c, 0x00, 0x80  //       JMP $8000
+  } },
+  { "zeropage", {
+    0xa2, 0x00,       // $8000 LDX #$00
+    0xb5, 0x10,       // $8002 LDA $10,X
+    0x65, 0x20,       //       ADC $20
+    0x95, 0x10,       //       STA $10,X
+    0xe6, 0x30,       //       INC $30
+    0xc6, 0x31,       //       DEC $31
+    0x26, 0x32,       //       ROL $32
+    0x46, 0x33,       //       LSR $33
+    0xe8,             //       INX
+    0xd0, 0xef,       //       BNE $8002
+    0x4c, 0x00, 0x80  //       JMP $8000
+  } },
+  { "memcpy", {
+    0xa9, 0x80,       // $8000 LDA #$80
+    0x85, 0x00,       //       STA $00
+    0x85, 0x02,       //       STA $02
+    0xa9, 0x02,       //       LDA #$02
+    0x85, 0x01,       //       STA $01
+    0xa9, 0x04,       //       LDA #$04
+    0x85, 0x03,       //       STA $03
+    0xa0, 0x00,       // $800E LDY #$00
+    0xb1, 0x00,       // $8010 LDA ($00),Y
+    0x91, 0x02,       //       STA ($02),Y
+    0xc8,             //       INY
+    0xd0, 0xf9,       //       BNE $8010
+    0x4c, 0x0e, 0x80  //       JMP $800E
+  } },
+  { "branch", {
+    0xa2, 0x00,       // $8000 LDX #$00
+    0x8a,             // $8002 TXA
+    0x29, 0x01,       //       AND #$01
+    0xf0, 0x04,       //       BEQ $800B
+    0xc8,             //       INY
+    0x4c, 0x0c, 0x80, //       JMP $800C
+    0x88,             // $800B DEY
+    0x8a,             // $800C TXA
+    0x29, 0x02,       //       AND #$02
+    0xd0, 0x01,       //       BNE $8012
+    0xea,             //       NOP
+    0xe8,             // $8012 INX
+    0x30, 0x02,       //       BMI $8017
+    0x10, 0x00,       //       BPL $8017
+    0xd0, 0xe9,       // $8017 BNE $8002
+    0x4c, 0x00, 0x80  //       JMP $8000
+  } },
+};
+
+// Rendering on, filling VRAM through $2007 in a loop
+static const Kernel RENDER_KERNEL = { "render", {
+  0xa9, 0x1e,       // $8000 LDA #$1E
+  0x8d, 0x01, 0x20, //       STA $2001
+  0xe6, 0x20,       // $8005 INC $20
+  0xa5, 0x20,       //       LDA $20
+  0x8d, 0x07, 0x20, //       STA $2007
+  0x4c, 0x05, 0x80  //       JMP $8005
+} };
+
+struct Result {
+  std::string name;
+  const char* unit;
+  std::vector<double> samples;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double runKernel(Console& console, const std::vector<uint8_t>& rom) {
+  console.loadROM(rom.data(), rom.size());
+  CPU6502& cpu = console.cpu;
+  uint64_t end = cpu.totalCycles + KERNEL_CYCLES;
+
+  Clock::time_point start = Clock::now();
+  while (cpu.totalCycles < end) cpu.step();
+  return KERNEL_CYCLES / secondsSince(start) / 1e6;
+}
+
+static volatile uint32_t sink;
+
+// Each access pattern walks its address range, so every page is touched
+static double runBus(Console& console, int pattern) {
+  CPU6502& cpu = console.cpu;
+  Bus& bus = console.bus;
+  uint32_t sum = 0;
+
+  Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < BUS_ACCESSES; i++) {
+    switch (pattern) {
+      case 0: sum += cpu.read(i & 0x07ff); break;
+      case 1: sum += cpu.read(0x8000 | (i & 0x7fff)); break;
+      case 2: cpu.write(0x0200 | (i & 0x05ff), i); break;
+      case 3: sum += bus.read(i & 0x1fff); break;
+      case 4: sum += bus.read(0x2002); break;
+    }
+  }
+  sink = sum;
+  return BUS_ACCESSES / secondsSince(start) / 1e6;
+}
+
+static double runHash(Console& console, bool ram) {
+  uint64_t sum = 0;
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < HASH_FRAMES; i++) {
+    console.ppu.framebuffer[i % FRAMEBUFFER_SIZE]++;
+    sum += frameHash(console, ram);
+  }
+  sink = sum;
+
+  double bytes = FRAMEBUFFER_SIZE + (ram ? sizeof(console.bus.ram) : 0);
+  return HASH_FRAMES * bytes / secondsSince(start) / 1e9;
+}
+
+static double runVideo(Console& console, uint8_t format) {
+  std::vector<uint8_t> out(videoFrameSize(format));
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < VIDEO_FRAMES; i++) {
+    console.ppu.framebuffer[i % FRAMEBUFFER_SIZE]++;
+    convertFrame(console.ppu.framebuffer, format, out.data());
+  }
+  sink = out[VIDEO_FRAMES % out.size()];
+
+  return VIDEO_FRAMES / secondsSince(start);
+}
+
+static double runFrames(Console& console, const std::vector<uint8_t>& rom) {
+  console.loadROM(rom.data(), rom.size());
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < ROM_FRAMES; i++) console.runFrame();
+  return ROM_FRAMES / secondsSince(start);
+}
+
+static double runCycleFrames(Console& console, const std::vector<uint8_t>& rom) {
+  console.loadROM(rom.data(), rom.size());
+  CycleEngine engine(&console);
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < ROM_FRAMES; i++) engine.runFrame();
+  return ROM_FRAMES / secondsSince(start);
+}
+
+static void printResult(const Result& r, bool last) {
+  std::vector<double> sorted = r.samples;
+  std::sort(sorted.begin(), sorted.end());
+  double median = sorted[sorted.size() / 2];
+
+  std::vector<double> deviations;
+  for (double s : sorted) deviations.push_back(s > median ? s - median : median - s);
+  std::sort(deviations.begin(), deviations.end());
+
+  printf("    { \"name\": \"%s\", \"unit\": \"%s\", \"median\": %.3f, \"min\": %.3f, \"max\": %.3f, \"mad\": %.3f, \"samples\": %zu }%s\n",
+    r.name.c_str(), r.unit, median, sorted.front(), sorted.back(), deviations[deviations.size() / 2], sorted.size(), last ? "" : ",");
+}
+
+int main(int argc, char** argv) {
+  int repetitions = DEFAULT_REPETITIONS;
+  std::vector<const char*> roms;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      repetitions = atoi(argv[++i]);
+    } else {
+      roms.push_back(argv[i]);
+    }
+  }
+  if (repetitions < 1) repetitions = 1;
+
+  Console* console = new Console();
+  std::vector<Result> results;
+
+  for (const Kernel& kernel : KERNELS) {
+    std::vector<uint8_t> rom = buildROM(kernel.code.data(), kernel.code.size(), 0x8000, 0x8000);
+    Result r = { std::string("kernel/") + kernel.name, "MHz", {} };
+    for (int i = 0; i < repetitions; i++) r.samples.push_back(runKernel(*console, rom));
+    results.push_back(r);
+  }
+
+  const char* busNames[] = { "cpu-read-ram", "cpu-read-prg", "cpu-write-ram", "bus-read-ram", "bus-read-ppu" };
+  std::vector<uint8_t> renderROM = buildROM(RENDER_KERNEL.code.data(), RENDER_KERNEL.code.size(), 0x8000, 0x8000);
+  (*console).loadROM(renderROM.data(), renderROM.size());
+  for (int pattern = 0; pattern < 5; pattern++) {
+    Result r = { std::string("bus/") + busNames[pattern], "Maccesses/s", {} };
+    for (int i = 0; i < repetitions; i++) r.samples.push_back(runBus(*console, pattern));
+    results.push_back(r);
+  }
+
+  for (int ram = 0; ram < 2; ram++) {
+    Result r = { ram ? "hash/frame-ram" : "hash/frame", "GB/s", {} };
+    for (int i = 0; i < repetitions; i++) r.samples.push_back(runHash(*console, ram));
+    results.push_back(r);
+  }
+
+  for (uint8_t format = VIDEO_RGBA; format <= VIDEO_YUV420; format++) {
+    Result r = { format == VIDEO_RGBA ? "video/rgba" : "video/yuv420", "fps", {} };
+    for (int i = 0; i < repetitions; i++) r.samples.push_back(runVideo(*console, format));
+    results.push_back(r);
+  }
+
+  Result render = { "rom/render", "fps", {} };
+  Result cycleRender = { "cycle/render", "fps", {} };
+  for (int i = 0; i < repetitions; i++) {
+    render.samples.push_back(runFrames(*console, renderROM));
+    cycleRender.samples.push_back(runCycleFrames(*console, renderROM));
+  }
+  results.push_back(render);
+  results.push_back(cycleRender);
+
+  for (const char* path : roms) {
+    std::vector<uint8_t> rom;
+    if (!readFile(path, rom) || !(*console).loadROM(rom.data(), rom.size())) {
+      fprintf(stderr, "cannot load %s\n", path);
+      return 2;
+    }
+
+    const char* base = strrchr(path, '/');
+    Result r = { std::string("rom/") + (base ? base + 1 : path), "fps", {} };
+    Result cycle = { std::string("cycle/") + (base ? base + 1 : path), "fps", {} };
+    for (int i = 0; i < repetitions; i++) {
+      r.samples.push_back(runFrames(*console, rom));
+      cycle.samples.push_back(runCycleFrames(*console, rom));
+    }
+    results.push_back(r);
+    results.push_back(cycle);
+  }
+
+  printf("{\n  \"compiler\": \"%s\",\n  \"repetitions\": %d,\n  \"results\": [\n", __VERSION__, repetitions);
+  for (size_t i = 0; i < results.size(); i++) printResult(results[i], i + 1 == results.size());
+  printf("  ]\n}\n");
+
+  delete console;
+  return 0;
+}
@@ -0,0 +1,331 @@
+// nes-check: CPU conformance runner.
+//
+// Usage: nes-check nestest rom log
+//        nes-check functional image [success-address]
+//        nes-check blargg [-j threads] [-f frames] [-s] rom...
+//
+// nestest runs nestest.nes in automation mode (from $C000) and compares
+// every instruction against nestest.log as it goes: PC, instruction bytes,
+// A, X, Y, P, SP and the cycle count. The first line that differs stops the
+// run and is printed next to what the core did.
+//
+// functional runs Klaus Dormann's 6502_functional_test.bin, a flat 64KB
+// image started at $0400, until it traps in a jump or branch to itself. It
+// passes if the trap is the success address ($3469 by default). The 2A03 has
+// no decimal mode, so the image should be assembled with disable_decimal = 1
+// and its success address passed in.
+//
+// blargg runs test ROMs that report through PRG-RAM: once $6001-$6003 hold
+// DE B0 61, $6000 is the status ($80 while running, $81 to ask for a reset
+// and anything else the final result, 0 for a pass) and $6004 on is the
+// message. The ROMs are run across all cores without rendering, each until
+// it finishes or runs out of frames (BLARGG_FRAMES by default). A line per
+// ROM is printed in argument order. ROMs the core can't load (unsupported
+// mappers, mostly) are reported as skipped, and ones that can't be read
+// fail. Skips fail the suite too unless -s allows them; even then the
+// summary only says ok when no ROM was skipped, and says skip otherwise.
+//
+// Exits 0 on a pass, 1 on a divergence, failed trap or failed ROM and 2 on
+// bad input.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Console.h"
+#include "Trace.h"
+#include "common.h"
+
+#define FUNCTIONAL_START 0x0400
+#define FUNCTIONAL_SUCCESS 0x3469
+#define FUNCTIONAL_MAX_INSTRUCTIONS 200000000ull
+
+// A minute of emulated time
+#define BLARGG_FRAMES 3600
+// Frames to hold before pressing reset; the ROMs ask for at least 100ms
+#define BLARGG_RESET_DELAY 6
+#define BLARGG_RUNNING 0x80
+#define BLARGG_RESET 0x81
+
+// Read without side effects; I/O pages read as 0
+static uint8_t peek(Bus& bus, uint16_t address) {
+  uint8_t* page = bus.readPages[address >> 8];
+  return page ? page[address & 0xff] : 0;
+}
+
+static TraceRecord capture(Console& console) {
+  CPU6502& cpu = console.cpu;
+  TraceRecord r;
+  r.pc = cpu.pc;
+  r.opcode = peek(console.bus, cpu.pc);
+  r.operands[0] = peek(console.bus, cpu.pc + 1);
+  r.operands[1] = peek(console.bus, cpu.pc + 2);
+  r.a = cpu.a;
+  r.x = cpu.x;
+  r.y = cpu.y;
+  r.p = cpu.p;
+  r.sp = cpu.sp;
+  memcpy(r.cycle, &cpu.totalCycles, sizeof(r.cycle));
+  return r;
+}
+
+static bool field(const char* line, const char* name, unsigned long long& value, int base) {
+  const char* at = strstr(line, name);
+  if (!at) return false;
+  value = strtoull(at + strlen(name), 0, base);
+  return true;
+}
+
+// Compare the columns both logs carry; the disassembly differs in
+// annotations and unofficial mnemonic names, so it is skipped
+static bool matches(const char* expected, const char* actual) {
+  if (strncmp(expected, actual, 14) != 0) return false;
+
+  const char* registers[] = { "A:", "X:", "Y:", "P:", "SP:" };
+  for (const char* name : registers) {
+    unsigned long long e, a;
+    if (!field(expected, name, e, 16) || !field(actual, name, a, 16) || e != a) return false;
+  }
+
+  unsigned long long e, a;
+  return field(expected, "CYC:", e, 10) && field(actual, "CYC:", a, 10) && e == a;
+}
+
+static int runNestest(const char* romPath, const char* logPath) {
+  std::vector<uint8_t> rom;
+  Console* console = new Console();
+  if (!readFile(romPath, rom) || !(*console).loadROM(rom.data(), rom.size())) {
+    fprintf(stderr, "cannot load %s\n", romPath);
+    delete console;
+    return 2;
+  }
+
+  FILE* log = fopen(logPath, "r");
+  if (!log) {
+    fprintf(stderr, "cannot read %s\n", logPath);
+    delete console;
+    return 2;
+  }
+
+  // Automation mode starts at $C000 with the state the log's first line has
+  (*console).cpu.pc = 0xc000;
+
+  char expected[256];
+  char actual[TRACE_LINE_SIZE];
+  char previous[TRACE_LINE_SIZE] = "";
+  unsigned lineNumber = 0;
+  int result = 0;
+
+  while (fgets(expected, sizeof(expected), log)) {
+    expected[strcspn(expected, "\r\n")] = '\0';
+    if (expected[0] == '\0') continue;
+    lineNumber++;
+
+    formatTrace(capture(*console), actual, sizeof(actual));
+    if (!matches(expected, actual)) {
+      printf("nestest: diverged at %s:%u\n", logPath, lineNumber);
+      if (previous[0]) printf("  previous  %s\n", previous);
+      printf("  expected  %s\n", expected);
+      printf("  actual    %s\n", actual);
+      result = 1;
+      break;
+    }
+
+    memcpy(previous, actual, sizeof(previous));
+    (*console).step();
+  }
+  fclose(log);
+
+  if (result == 0) {
+    // nestest leaves its error codes in $02 and $03
+    uint8_t official = (*console).bus.ram[0x02];
+    uint8_t unofficial = (*console).bus.ram[0x03];
+    printf("nestest: %s (%u instructions, $02=%02X $03=%02X)\n", official || unofficial ? "FAIL" : "ok", lineNumber, official, unofficial);
+    if (official || unofficial) result = 1;
+  }
+
+  delete console;
+  return result;
+}
+
+static int runFunctional(const char* imagePath, uint16_t success) {
+  std::vector<uint8_t> image;
+  if (!readFile(imagePath, image) || image.size() != 0x10000) {
+    fprintf(stderr, "cannot load %s (expected a 64KB image)\n", imagePath);
+    return 2;
+  }
+
+  // Flat RAM: internal RAM backs the first 2KB, where the CPU expects the
+  // zero page and the stack, and the image backs everything above it
+  Console* console = new Console();
+  Bus& bus = (*console).bus;
+  memcpy(bus.ram, image.data(), RAM_SIZE);
+  for (int page = 0; page < PAGE_COUNT; page++) {
+    uint8_t* memory = page < (RAM_SIZE >> 8) ? &bus.ram[page << 8] : &image[page << 8];
+    bus.readPages[page] = bus.writePages[page] = memory;
+  }
+
+  CPU6502& cpu = (*console).cpu;
+  cpu.pc = FUNCTIONAL_START;
+
+  uint64_t instructions = 0;
+  while (instructions < FUNCTIONAL_MAX_INSTRUCTIONS) {
+    uint16_t pc = cpu.pc;
+    (*console).step();
+    instructions++;
+    if (cpu.pc == pc) break;
+  }
+
+  int result = 0;
+  if (cpu.pc == success) {
+    printf("functional: ok (%llu instructions)\n", (unsigned long long)instructions);
+  } else {
+    char line[TRACE_LINE_SIZE];
+    formatTrace(capture(*console), line, sizeof(line));
+    printf("functional: trapped at $%04X after %llu instructions, expected $%04X\n  %s\n",
+      cpu.pc, (unsigned long long)instructions, success, line);
+    result = 1;
+  }
+
+  delete console;
+  return result;
+}
+
+struct BlarggResult {
+  enum { Pass, Fail, Timeout, Skip } outcome;
+  uint8_t status;
+  uint32_t frames;
+  std::string message;
+};
+
+static bool blarggValid(const uint8_t* ram) {
+  return ram[1] == 0xde && ram[2] == 0xb0 && ram[3] == 0x61;
+}
+
+// PRG-RAM is mapped straight into the CPU's page table, so the status is
+// polled once a frame rather than caught on the write; a result is never
+// more than a frame late
+static BlarggResult runBlarggROM(Console& console, const char* path, uint32_t maxFrames) {
+  std::vector<uint8_t> rom;
+  if (!readFile(path, rom)) return { BlarggResult::Fail, 0, 0, "cannot read rom" };
+  if (!console.loadROM(rom.data(), rom.size())) return { BlarggResult::Skip, 0, 0, "unsupported rom" };
+
+  // Stale results from the last ROM would otherwise count
+  const uint8_t* ram = console.cart.prgRam;
+  memset(console.cart.prgRam, 0, PRG_RAM_SIZE);
+  console.ppu.skipRender = 1;
+
+  uint32_t resetAt = 0;
+  uint32_t frame = 0;
+  while (frame < maxFrames) {
+    console.runFrame();
+    frame++;
+    if (!blarggValid(ram) || ram[0] == BLARGG_RUNNING) continue;
+
+    if (ram[0] == BLARGG_RESET) {
+      if (!resetAt) {
+        resetAt = frame + BLARGG_RESET_DELAY;
+      } else if (frame >= resetAt) {
+        console.cpu.reset();
+        resetAt = 0;
+      }
+      continue;
+    }
+    break;
+  }
+
+  // The message is whatever text is there, finished or not
+  std::string message;
+  if (blarggValid(ram)) {
+    for (int i = 4; i < PRG_RAM_SIZE && ram[i]; i++) message += (char)ram[i];
+  }
+  while (!message.empty() && (message.back() == '\n' || message.back() == ' ')) message.pop_back();
+
+  if (frame >= maxFrames && (!blarggValid(ram) || ram[0] >= BLARGG_RUNNING)) return { BlarggResult::Timeout, ram[0], frame, message };
+  return { ram[0] ? BlarggResult::Fail : BlarggResult::Pass, ram[0], frame, message };
+}
+
+static int runBlargg(int argc, char** argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  uint32_t frames = BLARGG_FRAMES;
+  bool allowSkips = false;
+  std::vector<const char*> roms;
+
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      frames = strtoul(argv[++i], 0, 10);
+    } else if (strcmp(argv[i], "-s") == 0) {
+      allowSkips = true;
+    } else {
+      roms.push_back(argv[i]);
+    }
+  }
+  if (roms.empty()) return 2;
+
+  if (threads == 0) threads = 1;
+  if (threads > roms.size()) threads = roms.size();
+
+  // ROMs take wildly different times, so workers take the next one as they
+  // finish rather than a fixed share
+  std::vector<BlarggResult> results(roms.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; t++) {
+    pool.emplace_back([&]() {
+      Console* console = new Console();
+      for (size_t i; (i = next++) < roms.size();) results[i] = runBlarggROM(*console, roms[i], frames);
+      delete console;
+    });
+  }
+  for (std::thread& t : pool) t.join();
+
+  const char* outcomes[] = { "ok", "FAIL", "TIMEOUT", "skip" };
+  unsigned passed = 0, failed = 0, skipped = 0;
+  for (size_t i = 0; i < roms.size(); i++) {
+    const BlarggResult& r = results[i];
+    if (r.outcome == BlarggResult::Skip) {
+      printf("%-7s %s: %s\n", outcomes[r.outcome], roms[i], r.message.c_str());
+      skipped++;
+      continue;
+    }
+
+    printf("%-7s %s (%u frames", outcomes[r.outcome], roms[i], r.frames);
+    if (r.outcome != BlarggResult::Pass) printf(", status $%02X", r.status);
+    printf(")\n");
+    if (r.outcome != BlarggResult::Pass && !r.message.empty()) {
+      // Indent every line of the ROM's own report
+      printf("  ");
+      for (char c : r.message) printf(c == '\n' ? "\n  " : "%c", c);
+      printf("\n");
+    }
+    if (r.outcome == BlarggResult::Pass) passed++; else failed++;
+  }
+  // A suite that passes only because nothing ran is not a pass
+  bool fail = failed || (skipped && !allowSkips);
+  const char* summary = fail ? "FAIL" : skipped || !passed ? "skip" : "ok";
+  printf("blargg: %s (%u passed, %u failed, %u skipped)\n", summary, passed, failed, skipped);
+  return fail ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 4 && strcmp(argv[1], "nestest") == 0) {
+    return runNestest(argv[2], argv[3]);
+  }
+  if ((argc == 3 || argc == 4) && strcmp(argv[1], "functional") == 0) {
+    return runFunctional(argv[2], argc == 4 ? strtoul(argv[3], 0, 16) : FUNCTIONAL_SUCCESS);
+  }
+  if (argc >= 3 && strcmp(argv[1], "blargg") == 0) {
+    int result = runBlargg(argc - 2, argv + 2);
+    if (result != 2) return result;
+  }
+
+  fprintf(stderr, "usage: %s nestest rom log\n       %s functional image [success-address]\n       %s blargg [-j threads] [-f frames] [-s] rom...\n", argv[0], argv[0], argv[0]);
+  return 2;
+}
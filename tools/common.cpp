@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "Cartridge.h"
+
+bool readFile(const char* path, std::vector<uint8_t>& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  out.resize(size > 0 ? size : 0);
+  bool ok = size >= 0 && fread(out.data(), 1, out.size(), f) == out.size();
+  fclose(f);
+  return ok;
+}
+
+std::vector<uint8_t> buildROM(const uint8_t* program, size_t size, uint16_t reset, uint16_t nmi) {
+  std::vector<uint8_t> rom(INES_HEADER_SIZE + PRG_BANK_SIZE + CHR_BANK_SIZE, 0);
+  const uint8_t header[] = { 'N', 'E', 'S', 0x1a, 1, 1, 0x01, 0 };
+  memcpy(rom.data(), header, sizeof(header));
+
+  uint8_t* prg = &rom[INES_HEADER_SIZE];
+  memcpy(prg, program, size);
+  const uint8_t vectors[] = {
+    (uint8_t)(nmi & 0xff), (uint8_t)(nmi >> 8),
+    (uint8_t)(reset & 0xff), (uint8_t)(reset >> 8),
+    (uint8_t)(reset & 0xff), (uint8_t)(reset >> 8)
+  };
+  memcpy(&prg[0x3ffa], vectors, sizeof(vectors));
+
+  uint8_t* chr = &rom[INES_HEADER_SIZE + PRG_BANK_SIZE];
+  for (int i = 0; i < CHR_BANK_SIZE; i++) chr[i] = i * 7;
+
+  return rom;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Helpers shared by the host tools and the host tests
+
+// Read a whole file. Returns false if it can't be read.
+bool readFile(const char* path, std::vector<uint8_t>& out);
+
+// A 16KB NROM image, so the program at $8000 is mirrored at $C000, with the
+// given reset and NMI vectors and a patterned CHR bank
+std::vector<uint8_t> buildROM(const uint8_t* program, size_t size, uint16_t reset, uint16_t nmi);
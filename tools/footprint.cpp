@@ -0,0 +1,219 @@
+// nes-footprint: bytes per component and section from a GNU ld map file.
+//
+// Usage: nes-footprint [-c] map-file
+//
+// Every input section in the map is charged to the object it came from
+// (obj/CPU.o is "CPU", libc.a(printf.o) is "libc.a") under the output section
+// it was placed in. The table lists the largest output sections as columns
+// and components by total size; -c prints every cell as CSV instead, so two
+// builds can be diffed.
+//
+// For a Teensy 4.1 map (PlatformIO writes one with -Wl,-Map) the regions are
+// also checked against the budgets in Footprint.h: RAM1 holds ITCM, rounded
+// up to whole 32KB banks, plus DTCM (.data and .bss); RAM2 holds DMAMEM
+// (.bss.dma), and flash holds the rest. The exit status is 1 if any of
+// them is over.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Footprint.h"
+
+#define MAX_COLUMNS 6
+
+typedef std::map<std::string, uint64_t> Sizes;
+
+struct Component {
+  std::string name;
+  Sizes sections;
+  uint64_t total;
+};
+
+// Sections that take space in the image, as opposed to debug info and notes
+static bool allocated(const std::string& section) {
+  const char* skipped[] = { ".comment", ".debug", ".note", ".ARM.attributes", ".gnu_debuglink", ".stab", ".symtab", ".strtab", ".shstrtab" };
+  for (const char* prefix : skipped) {
+    if (section.compare(0, strlen(prefix), prefix) == 0) return false;
+  }
+  return true;
+}
+
+static std::string componentName(const std::string& file) {
+  std::string name = file;
+
+  // Archive members are charged to the archive
+  size_t paren = name.find('(');
+  if (paren != std::string::npos) name = name.substr(0, paren);
+
+  size_t slash = name.find_last_of('/');
+  if (slash != std::string::npos) name = name.substr(slash + 1);
+
+  // PlatformIO names objects after the whole source file, CPU.cpp.o
+  const char* suffixes[] = { ".o", ".cpp", ".c" };
+  for (const char* suffix : suffixes) {
+    size_t length = strlen(suffix);
+    if (name.size() > length && name.compare(name.size() - length, length, suffix) == 0) name = name.substr(0, name.size() - length);
+  }
+  return name;
+}
+
+static bool parseMap(const char* path, std::map<std::string, Sizes>& components) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+
+  char line[4096];
+  bool inMap = false;
+  std::string output;
+  std::string pending;
+
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (!inMap) {
+      inMap = strncmp(line, "Linker script and memory map", 28) == 0;
+      continue;
+    }
+    if (line[0] == '\0') continue;
+
+    // Output sections start in column 0
+    if (line[0] != ' ') {
+      char name[1024];
+      output = sscanf(line, "%1023s", name) == 1 && name[0] == '.' ? name : "";
+      pending.clear();
+      continue;
+    }
+
+    // Input sections are indented by one space; a long name puts the
+    // address, size and file on the next line
+    char name[1024] = "", file[2048] = "";
+    unsigned long long address, size;
+    const char* rest = line;
+    if (line[1] != ' ') {
+      int used = 0;
+      if (sscanf(line, " %1023s%n", name, &used) != 1) continue;
+      if (strncmp(name, "*(", 2) == 0 || strchr(name, '(')) continue;
+      rest = line + used;
+      if (sscanf(rest, " %llx %llx %2047[^\n]", &address, &size, file) < 2) {
+        pending = name;
+        continue;
+      }
+    } else if (!pending.empty()) {
+      if (sscanf(line, " %llx %llx %2047[^\n]", &address, &size, file) < 2) {
+        pending.clear();
+        continue;
+      }
+      pending.clear();
+    } else {
+      continue;
+    }
+
+    if (output.empty() || !allocated(output) || size == 0) continue;
+    std::string component = strcmp(name, "*fill*") == 0 ? "(padding)" : file[0] ? componentName(file) : "(linker)";
+    components[component][output] += size;
+  }
+
+  fclose(f);
+  return inMap;
+}
+
+static uint64_t roundUp(uint64_t value, uint64_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+static bool checkRegion(const char* name, uint64_t used, uint64_t budget) {
+  bool ok = used <= budget;
+  printf("%-6s %8llu of %8llu bytes (%5.1f%%)%s\n", name, (unsigned long long)used, (unsigned long long)budget,
+    100.0 * used / budget, ok ? "" : "  OVER BUDGET");
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  bool csv = false;
+  const char* path = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-c") == 0) {
+      csv = true;
+    } else {
+      path = argv[i];
+    }
+  }
+
+  if (!path) {
+    fprintf(stderr, "usage: %s [-c] map-file\n", argv[0]);
+    return 2;
+  }
+
+  std::map<std::string, Sizes> parsed;
+  if (!parseMap(path, parsed)) {
+    fprintf(stderr, "cannot read a memory map from %s\n", path);
+    return 2;
+  }
+
+  std::vector<Component> components;
+  Sizes sections;
+  for (auto& entry : parsed) {
+    Component c = { entry.first, entry.second, 0 };
+    for (auto& section : entry.second) {
+      c.total += section.second;
+      sections[section.first] += section.second;
+    }
+    components.push_back(c);
+  }
+  std::sort(components.begin(), components.end(), [](const Component& a, const Component& b) {
+    return a.total != b.total ? a.total > b.total : a.name < b.name;
+  });
+
+  if (csv) {
+    printf("component,section,bytes\n");
+    for (const Component& c : components) {
+      for (auto& section : c.sections) printf("%s,%s,%llu\n", c.name.c_str(), section.first.c_str(), (unsigned long long)section.second);
+    }
+    return 0;
+  }
+
+  // The largest sections get columns, the rest are summed into "other"
+  std::vector<std::pair<uint64_t, std::string>> bySize;
+  for (auto& section : sections) bySize.push_back({ section.second, section.first });
+  std::sort(bySize.rbegin(), bySize.rend());
+  std::vector<std::string> columns;
+  for (size_t i = 0; i < bySize.size() && i < MAX_COLUMNS; i++) columns.push_back(bySize[i].second);
+
+  printf("%-24s", "component");
+  for (const std::string& column : columns) printf(" %12s", column.c_str());
+  printf(" %12s %12s\n", "other", "total");
+
+  Component total = { "total", sections, 0 };
+  for (auto& section : sections) total.total += section.second;
+  components.push_back(total);
+
+  for (const Component& c : components) {
+    printf("%-24s", c.name.c_str());
+    uint64_t other = c.total;
+    for (const std::string& column : columns) {
+      auto found = c.sections.find(column);
+      uint64_t bytes = found == c.sections.end() ? 0 : found->second;
+      other -= bytes;
+      printf(" %12llu", (unsigned long long)bytes);
+    }
+    printf(" %12llu %12llu\n", (unsigned long long)other, (unsigned long long)c.total);
+  }
+
+  // Teensy 4 linker script sections
+  if (!sections.count(".text.itcm")) return 0;
+
+  uint64_t ram1 = roundUp(sections[".text.itcm"], FOOTPRINT_ITCM_BANK) + sections[".data"] + sections[".bss"];
+  uint64_t ram2 = sections[".bss.dma"];
+  uint64_t flash = sections[".text.progmem"] + sections[".text.itcm"] + sections[".data"] + sections[".ARM.exidx"] +
+    sections[".text.headers"] + sections[".text.csf"];
+
+  printf("\n");
+  bool ok = checkRegion("RAM1", ram1, FOOTPRINT_RAM1);
+  ok = checkRegion("RAM2", ram2, FOOTPRINT_RAM2) && ok;
+  ok = checkRegion("FLASH", flash, FOOTPRINT_FLASH) && ok;
+  return ok ? 0 : 1;
+}
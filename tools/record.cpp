@@ -0,0 +1,111 @@
+// nes-record: run a ROM headless and stream its video.
+//
+// Usage: nes-record [-f rgba|yuv|y4m] [-s interval] [-l] rom movie frames output
+//
+// movie is a movie file (see Movie.h) or "-" for no input, and output is a
+// file or "-" for stdout, so frames can be piped straight into an encoder:
+//
+//   nes-record -f y4m game.nes - 3600 - | ffmpeg -i - game.mp4
+//   nes-record game.nes - 3600 - | ffmpeg -f rawvideo -pix_fmt rgba -s 256x240 -r 60.0988 -i - game.mp4
+//
+// rgba (the default) and yuv are raw frames back to back; y4m is YUV420 in
+// a YUV4MPEG2 stream. With -s only one frame in every interval is rendered
+// and written (see FastForward.h). The achieved speed is printed as a
+// multiple of real time when the run ends.
+//
+// -l also measures the latency from each change of input in the movie to
+// the game reading it, the picture changing and the frame being written
+// (see Latency.h), and prints the histograms at the end.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Console.h"
+#include "FastForward.h"
+#include "Latency.h"
+#include "Movie.h"
+#include "Video.h"
+#include "common.h"
+
+int main(int argc, char** argv) {
+  const char* format = "rgba";
+  uint32_t interval = 1;
+  bool latency = false;
+  int arg = 1;
+  while (arg + 1 < argc && argv[arg][0] == '-' && argv[arg][1] != '\0') {
+    if (strcmp(argv[arg], "-l") == 0) {
+      latency = true;
+      arg++;
+      continue;
+    } else if (strcmp(argv[arg], "-f") == 0) {
+      format = argv[arg + 1];
+    } else if (strcmp(argv[arg], "-s") == 0) {
+      interval = strtoul(argv[arg + 1], 0, 10);
+    } else {
+      break;
+    }
+    arg += 2;
+  }
+
+  bool y4m = strcmp(format, "y4m") == 0;
+  bool yuv = y4m || strcmp(format, "yuv") == 0;
+  if (argc - arg != 4 || (!yuv && strcmp(format, "rgba") != 0)) {
+    fprintf(stderr, "usage: %s [-f rgba|yuv|y4m] [-s interval] [-l] rom movie frames output\n", argv[0]);
+    return 2;
+  }
+
+  const char* romPath = argv[arg];
+  const char* moviePath = argv[arg + 1];
+  uint32_t frames = strtoul(argv[arg + 2], 0, 10);
+  const char* output = argv[arg + 3];
+
+  std::vector<uint8_t> rom, data;
+  Console* console = new Console();
+  if (!readFile(romPath, rom) || !(*console).loadROM(rom.data(), rom.size())) {
+    fprintf(stderr, "cannot load %s\n", romPath);
+    return 2;
+  }
+
+  Movie movie;
+  if (strcmp(moviePath, "-") != 0 && (!readFile(moviePath, data) || !movie.load(data.data(), data.size()))) {
+    fprintf(stderr, "cannot load movie %s\n", moviePath);
+    return 2;
+  }
+
+  VideoWriter writer;
+  if (!writer.open(output, yuv ? VIDEO_YUV420 : VIDEO_RGBA, y4m)) {
+    fprintf(stderr, "cannot open %s\n", output);
+    return 2;
+  }
+
+  FastForward fastForward(console, interval);
+  LatencyMeter* meter = latency ? new LatencyMeter(console) : 0;
+  bool ok = true;
+  for (uint32_t frame = 0; frame < frames && ok; frame++) {
+    movie.play(*console);
+    if (meter) (*meter).beginFrame();
+    bool presented = fastForward.runFrame();
+    if (meter) (*meter).endFrame();
+    if (presented) {
+      ok = writer.capture((*console).ppu.framebuffer);
+      if (meter) (*meter).presented();
+    }
+  }
+  ok = writer.close() && ok;
+  double speed = fastForward.speed();
+
+  if (!ok) {
+    fprintf(stderr, "write to %s failed after %llu frames\n", output, (unsigned long long)writer.framesWritten());
+    return 1;
+  }
+
+  fprintf(stderr, "%u frames, %llu written, %.1fx real time\n", frames, (unsigned long long)writer.framesWritten(), speed);
+  if (meter) (*meter).report(stderr);
+
+  delete meter;
+  delete console;
+  return 0;
+}
@@ -0,0 +1,50 @@
+// nes-trace: decode a binary trace ring into nestest.log format.
+//
+// Usage: nes-trace trace-file
+//
+// Records are printed oldest first. Operands are shown as encoded; unlike
+// nestest.log there are no "= value" annotations for memory operands and no
+// PPU column, since the trace doesn't record memory or PPU state.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "Trace.h"
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s trace-file\n", argv[0]);
+    return 2;
+  }
+
+  FILE* f = fopen(argv[1], "rb");
+  TraceHeader header;
+  if (!f || fread(&header, sizeof(header), 1, f) != 1) {
+    fprintf(stderr, "cannot read %s\n", argv[1]);
+    return 2;
+  }
+  if (memcmp(header.magic, "TNTR", 4) != 0 || header.version != TRACE_VERSION || header.recordSize != sizeof(TraceRecord) ||
+      header.capacity == 0 || (header.capacity & (header.capacity - 1))) {
+    fprintf(stderr, "%s is not a version %d trace\n", argv[1], TRACE_VERSION);
+    return 2;
+  }
+
+  std::vector<TraceRecord> records(header.capacity);
+  if (fread(records.data(), sizeof(TraceRecord), records.size(), f) != records.size()) {
+    fprintf(stderr, "%s is truncated\n", argv[1]);
+    return 2;
+  }
+  fclose(f);
+
+  uint64_t count = header.head < header.capacity ? header.head : header.capacity;
+  for (uint64_t i = header.head - count; i < header.head; i++) {
+    const TraceRecord& r = records[i & (header.capacity - 1)];
+    char line[TRACE_LINE_SIZE];
+    formatTrace(r, line, sizeof(line));
+    puts(line);
+  }
+
+  return 0;
+}